@@ -569,12 +569,14 @@ typedef struct
 	uint32_t  fc;         /* fnum,blk:adjusted to sample rate */
 	uint8_t   kcode;      /* key code:                        */
 	uint32_t  block_fnum; /* current blk/fnum value for this slot (can be different betweeen slots of one channel in 3slot mode) */
+	
+	uint8_t   active;     /* keyed on since it was last found idle */
 } FM_CH;
 
 typedef struct
 {
 	int         clock;              /* master clock  (Hz)   */
-	int         rate;               /* sampling rate (Hz)   */
+	double      rate;               /* sampling rate (Hz)   */
 	double      freqbase;           /* frequency base       */
 	int         timer_prescaler;    /* timer prescaler      */
 #if FM_BUSY_FLAG_SUPPORT
@@ -828,6 +830,7 @@ static INLINE uint8_t FM_STATUS_FLAG(FM_ST *ST)
 static INLINE void FM_KEYON(uint8_t type, FM_CH *CH , int s )
 {
 	FM_SLOT *SLOT = &CH->SLOT[s];
+	CH->active = 1;
 	if( !SLOT->key )
 	{
 		SLOT->key = 1;
@@ -1475,6 +1478,7 @@ static void reset_channels( FM_ST *ST , FM_CH *CH , int num )
 	for( c = 0 ; c < num ; c++ )
 	{
 		CH[c].fc = 0;
+		CH[c].active = 1;   /* until the feedback samples are drained */
 		for(s = 0 ; s < 4 ; s++ )
 		{
 			CH[c].SLOT[s].ssg = 0;
@@ -1649,7 +1653,7 @@ static void OPNSetPres(FM_OPN *OPN, int pres, int timer_prescaler, int SSGpres)
 	OPN->ST.timer_prescaler = timer_prescaler;
 	
 	/* SSG part  prescaler set */
-	if( SSGpres ) ssg_set_clock(&OPN->ST.ssg, OPN->ST.clock * 2 / SSGpres);
+	if( SSGpres ) ssg_set_clock(&OPN->ST.ssg, OPN->ST.clock * 2 / SSGpres, OPN->ST.rate);
 	
 	/* make time tables */
 	init_timetables( &OPN->ST, dt_tab );
@@ -2200,7 +2204,7 @@ void ssg_needs_update() {
 
 #pragma mark - YM2610 API
 
-void ym2610_init(int clock, int rate, void *pcmroma, size_t pcmsizea, void *pcmromb,
+void ym2610_init(int clock, double rate, void *pcmroma, size_t pcmsizea, void *pcmromb,
 		size_t pcmsizeb, FM_TIMERHANDLER timer_handler, FM_IRQHANDLER IRQHandler)
 {
 	ym2610_state *F2610 = &ym2610_device;
@@ -2456,15 +2460,182 @@ int ym2610_timerOver(int c)
 	return F2610->OPN.ST.irq;
 }
 
-/* Generate samples for one of the YM2610s */
-void ym2610_update(int length)
+/* Voices are synthesized by blocks, each one in turn, then mixed */
+#define YM2610_BLOCK_LENGTH	SSG_UPDATE_MAX_LENGTH
+
+static int32_t block_left[YM2610_BLOCK_LENGTH];
+static int32_t block_right[YM2610_BLOCK_LENGTH];
+static int32_t block_ssg[YM2610_BLOCK_LENGTH];
+
+/* inaudible voices are not computed, their phases stand still (not bit exact) */
+static bool skip_silent;
+
+/* all the operators off and the feedback and MEM samples drained: nothing
+   can come out before a key on, which restarts the phases. The EG_OFF
+   envelopes don't move, their vol_out stay above ENV_QUIET whatever the TL */
+static INLINE bool chan_is_idle(FM_CH *CH)
+{
+	return CH->SLOT[SLOT1].state == EG_OFF && CH->SLOT[SLOT2].state == EG_OFF
+		&& CH->SLOT[SLOT3].state == EG_OFF && CH->SLOT[SLOT4].state == EG_OFF
+		&& CH->op1_out[0] == 0 && CH->op1_out[1] == 0 && CH->mem_value == 0;
+}
+
+/* every operator under the audible threshold, AM can only lower them */
+static INLINE bool chan_is_silent(FM_CH *CH)
+{
+	return CH->SLOT[SLOT1].vol_out >= ENV_QUIET && CH->SLOT[SLOT2].vol_out >= ENV_QUIET
+		&& CH->SLOT[SLOT3].vol_out >= ENV_QUIET && CH->SLOT[SLOT4].vol_out >= ENV_QUIET;
+}
+
+static void ym2610_update_fm(FM_CH *cch[4], int length)
+{
+	FM_OPN *OPN = &ym2610_device.OPN;
+	int32_t *out_fm = OPN->out_fm;
+	
+	for (int i = 0; i < length; i++)
+	{
+		advance_lfo(OPN);
+		
+		/* clear outputs */
+		out_fm[1] = 0;
+		out_fm[2] = 0;
+		out_fm[4] = 0;
+		out_fm[5] = 0;
+		
+		/* advance envelope generator */
+		OPN->eg_timer += OPN->eg_timer_add;
+		while (OPN->eg_timer >= OPN->eg_timer_overflow)
+		{
+			OPN->eg_timer -= OPN->eg_timer_overflow;
+			OPN->eg_cnt++;
+			
+			if (cch[0]->active) advance_eg_channel(OPN, &cch[0]->SLOT[SLOT1]);
+			if (cch[1]->active) advance_eg_channel(OPN, &cch[1]->SLOT[SLOT1]);
+			if (cch[2]->active) advance_eg_channel(OPN, &cch[2]->SLOT[SLOT1]);
+			if (cch[3]->active) advance_eg_channel(OPN, &cch[3]->SLOT[SLOT1]);
+		}
+		
+		/* calculate FM */
+		if (cch[0]->active && (!skip_silent || !chan_is_silent(cch[0]))) chan_calc(OPN, cch[0], 1 ); /*remapped to 1*/
+		if (cch[1]->active && (!skip_silent || !chan_is_silent(cch[1]))) chan_calc(OPN, cch[1], 2 ); /*remapped to 2*/
+		if (cch[2]->active && (!skip_silent || !chan_is_silent(cch[2]))) chan_calc(OPN, cch[2], 4 ); /*remapped to 4*/
+		if (cch[3]->active && (!skip_silent || !chan_is_silent(cch[3]))) chan_calc(OPN, cch[3], 5 ); /*remapped to 5*/
+		
+		/* the shift right was verified on real chip */
+		block_left[i] = ((out_fm[1]>>1) & OPN->pan[2]) + ((out_fm[2]>>1) & OPN->pan[4])
+					+ ((out_fm[4]>>1) & OPN->pan[8]) + ((out_fm[5]>>1) & OPN->pan[10]);
+		block_right[i] = ((out_fm[1]>>1) & OPN->pan[3]) + ((out_fm[2]>>1) & OPN->pan[5])
+					+ ((out_fm[4]>>1) & OPN->pan[9]) + ((out_fm[5]>>1) & OPN->pan[11]);
+		
+		/* timer A control */
+		INTERNAL_TIMER_A( &OPN->ST , cch[1] )
+	}
+	
+	/* skipped until their next key on */
+	for (int c = 0; c < 4; c++)
+	{
+		if (cch[c]->active && chan_is_idle(cch[c]))
+			cch[c]->active = 0;
+	}
+}
+
+/* the LFO and envelope counters of an idle chip, as ym2610_update_fm() would leave them */
+static void ym2610_skip_fm(int length)
+{
+	FM_OPN *OPN = &ym2610_device.OPN;
+	
+	if (OPN->lfo_inc)
+	{
+		OPN->lfo_cnt += OPN->lfo_inc * length;
+		uint8_t pos = (OPN->lfo_cnt >> LFO_SH) & 127;
+		OPN->LFO_AM = pos < 64 ? (pos&63) * 2 : 126 - ((pos&63) * 2);
+		OPN->LFO_PM = pos >> 2;
+	}
+	else
+	{
+		OPN->LFO_AM = 0;
+		OPN->LFO_PM = 0;
+	}
+	
+	uint32_t eg_timer = OPN->eg_timer + OPN->eg_timer_add * length;
+	OPN->eg_cnt += eg_timer / OPN->eg_timer_overflow;
+	OPN->eg_timer = eg_timer % OPN->eg_timer_overflow;
+}
+
+static bool ym2610_is_idle(FM_CH *cch[4])
+{
+	ym2610_state *F2610 = &ym2610_device;
+	
+	if (cch[0]->active || cch[1]->active || cch[2]->active || cch[3]->active)
+		return false;
+	if (F2610->deltaT.portstate & 0x80)
+		return false;
+	for (int j = 0; j < 6; j++)
+	{
+		if (F2610->adpcm[j].flag)
+			return false;
+	}
+	return true;
+}
+
+static void ym2610_update_adpcmb(int length)
+{
+	FM_OPN *OPN = &ym2610_device.OPN;
+	YM_DELTAT *DELTAT = &ym2610_device.deltaT;
+	
+	/* the channel stops by itself at its end address */
+	for (int i = 0; i < length && (DELTAT->portstate&0x80); i++)
+	{
+		OPN->out_delta[OUTD_LEFT] = OPN->out_delta[OUTD_RIGHT] = OPN->out_delta[OUTD_CENTER] = 0;
+		ADPCMB_CALC(DELTAT);
+		block_left[i] += (OPN->out_delta[OUTD_LEFT]  + OPN->out_delta[OUTD_CENTER])>>9;
+		block_right[i] += (OPN->out_delta[OUTD_RIGHT] + OPN->out_delta[OUTD_CENTER])>>9;
+	}
+}
+
+static void ym2610_update_adpcma(int length)
+{
+	FM_OPN *OPN = &ym2610_device.OPN;
+	
+	for (int j = 0; j < 6; j++)
+	{
+		ADPCM_CH *adpcm = &ym2610_device.adpcm[j];
+		for (int i = 0; i < length && adpcm->flag; i++)
+		{
+			OPN->out_adpcm[OUTD_LEFT] = OPN->out_adpcm[OUTD_RIGHT] = OPN->out_adpcm[OUTD_CENTER] = 0;
+			ADPCMA_calc_chan(adpcm);
+			block_left[i] += OPN->out_adpcm[OUTD_LEFT] + OPN->out_adpcm[OUTD_CENTER];
+			block_right[i] += OPN->out_adpcm[OUTD_RIGHT] + OPN->out_adpcm[OUTD_CENTER];
+		}
+	}
+}
+
+static void ym2610_mix(FMSAMPLE *buffer, int length)
+{
+	for (int i = 0; i < length; i++)
+	{
+		int32_t lt = (block_left[i] + block_ssg[i]) >> FINAL_SH;
+		int32_t rt = (block_right[i] + block_ssg[i]) >> FINAL_SH;
+		
+		lt = lt > MAXOUT ? MAXOUT : (lt < MINOUT ? MINOUT : lt);
+		rt = rt > MAXOUT ? MAXOUT : (rt < MINOUT ? MINOUT : rt);
+		
+		buffer[i * 2] = (FMSAMPLE)lt;
+		buffer[i * 2 + 1] = (FMSAMPLE)rt;
+	}
+}
+
+void ym2610_skip_silent(bool enabled)
+{
+	skip_silent = enabled;
+}
+
+/* Generate samples for one of the YM2610s, stereo interleaved */
+void ym2610_update(FMSAMPLE *buffer, int length)
 {
 	ym2610_state *F2610 = &ym2610_device;
 	FM_OPN *OPN   = &F2610->OPN;
-	YM_DELTAT *DELTAT = &F2610->deltaT;
-	int i,j;
 	FM_CH   *cch[4];
-	int32_t *out_fm = OPN->out_fm;
 	
 	cch[0] = &F2610->CH[1];
 	cch[1] = &F2610->CH[2];
@@ -2499,90 +2670,35 @@ void ym2610_update(int length)
 	refresh_fc_eg_chan( OPN, cch[2] );
 	refresh_fc_eg_chan( OPN, cch[3] );
 	
-	/* buffering */
-	for(i=0; i < length ; i++)
+	/* buffering, the voices don't depend on each other */
+	for (int done = 0; done < length; )
 	{
-		advance_lfo(OPN);
-		
-		/* clear output acc. */
-		OPN->out_adpcm[OUTD_LEFT] = OPN->out_adpcm[OUTD_RIGHT] = OPN->out_adpcm[OUTD_CENTER] = 0;
-		OPN->out_delta[OUTD_LEFT] = OPN->out_delta[OUTD_RIGHT] = OPN->out_delta[OUTD_CENTER] = 0;
-		/* clear outputs */
-		out_fm[1] = 0;
-		out_fm[2] = 0;
-		out_fm[4] = 0;
-		out_fm[5] = 0;
+		int block = length - done < YM2610_BLOCK_LENGTH ? length - done : YM2610_BLOCK_LENGTH;
 		
-		/* advance envelope generator */
-		OPN->eg_timer += OPN->eg_timer_add;
-		while (OPN->eg_timer >= OPN->eg_timer_overflow)
+		/* nothing playing: the constant output of a muted SSG */
+		int32_t ssg_level;
+		if (ym2610_is_idle(cch) && ssg_skip_muted(&OPN->ST.ssg, block, &ssg_level))
 		{
-			OPN->eg_timer -= OPN->eg_timer_overflow;
-			OPN->eg_cnt++;
-			
-			advance_eg_channel(OPN, &cch[0]->SLOT[SLOT1]);
-			advance_eg_channel(OPN, &cch[1]->SLOT[SLOT1]);
-			advance_eg_channel(OPN, &cch[2]->SLOT[SLOT1]);
-			advance_eg_channel(OPN, &cch[3]->SLOT[SLOT1]);
+			ym2610_skip_fm(block);
+			int32_t level = ssg_level >> FINAL_SH;
+			FMSAMPLE sample = (FMSAMPLE)(level > MAXOUT ? MAXOUT : (level < MINOUT ? MINOUT : level));
+			if (sample == 0)
+				memset(buffer + done * 2, 0, block * 2 * sizeof(FMSAMPLE));
+			else
+				for (int i = 0; i < block * 2; i++)
+					buffer[done * 2 + i] = sample;
+			done += block;
+			continue;
 		}
 		
-		/* calculate FM */
-		chan_calc(OPN, cch[0], 1 ); /*remapped to 1*/
-		chan_calc(OPN, cch[1], 2 ); /*remapped to 2*/
-		chan_calc(OPN, cch[2], 4 ); /*remapped to 4*/
-		chan_calc(OPN, cch[3], 5 ); /*remapped to 5*/
-		
-		/* deltaT ADPCM */
-		if( DELTAT->portstate&0x80 )
-			ADPCMB_CALC(DELTAT);
+		ym2610_update_fm(cch, block);
+		ym2610_update_adpcmb(block);
+		ym2610_update_adpcma(block);
+		if (!skip_silent || !ssg_update_muted(&OPN->ST.ssg, block_ssg, block))
+			ssg_update(&OPN->ST.ssg, block_ssg, block);
+		ym2610_mix(buffer + done * 2, block);
 		
-		/* ADPCMA */
-		for( j = 0; j < 6; j++ )
-		{
-			if( F2610->adpcm[j].flag )
-				ADPCMA_calc_chan(&F2610->adpcm[j]);
-		}
-		
-		/* buffering */
-		{
-			int lt,rt;
-			
-			lt =  OPN->out_adpcm[OUTD_LEFT]  + OPN->out_adpcm[OUTD_CENTER];
-			rt =  OPN->out_adpcm[OUTD_RIGHT] + OPN->out_adpcm[OUTD_CENTER];
-			lt += (OPN->out_delta[OUTD_LEFT]  + OPN->out_delta[OUTD_CENTER])>>9;
-			rt += (OPN->out_delta[OUTD_RIGHT] + OPN->out_delta[OUTD_CENTER])>>9;
-			
-			
-			lt += ((out_fm[1]>>1) & OPN->pan[2]);   /* the shift right was verified on real chip */
-			rt += ((out_fm[1]>>1) & OPN->pan[3]);
-			lt += ((out_fm[2]>>1) & OPN->pan[4]);
-			rt += ((out_fm[2]>>1) & OPN->pan[5]);
-			
-			lt += ((out_fm[4]>>1) & OPN->pan[8]);
-			rt += ((out_fm[4]>>1) & OPN->pan[9]);
-			lt += ((out_fm[5]>>1) & OPN->pan[10]);
-			rt += ((out_fm[5]>>1) & OPN->pan[11]);
-			
-			int32_t out_ssg = ssg_update_one_sample(&OPN->ST.ssg);
-			lt += out_ssg;
-			rt += out_ssg;
-			
-			lt >>= FINAL_SH;
-			rt >>= FINAL_SH;
-			
-			Limit( lt, MAXOUT, MINOUT );
-			Limit( rt, MAXOUT, MINOUT );
-			
-#ifdef SAVE_SAMPLE
-			SAVE_ALL_CHANNELS
-#endif
-			
-			/* buffering */
-			ym2610_update_audio_buffer(lt, rt);
-		}
-		
-		/* timer A control */
-		INTERNAL_TIMER_A( &OPN->ST , cch[1] )
+		done += block;
 	}
 	INTERNAL_TIMER_B(&OPN->ST,length)
 	
@@ -8,17 +8,19 @@
 #ifndef _YM2610_H_
 #define _YM2610_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef void(*FM_TIMERHANDLER) (int channel, int count, double stepTime);
 typedef void(*FM_IRQHANDLER) (int irq);
 
-void ym2610_init(int baseclock, int rate, void *pcmroma, size_t pcmsizea, void *pcmromb, size_t pcmsizeb, FM_TIMERHANDLER TimerHandler, FM_IRQHANDLER IRQHandler);
+void ym2610_init(int baseclock, double rate, void *pcmroma, size_t pcmsizea, void *pcmromb, size_t pcmsizeb, FM_TIMERHANDLER TimerHandler, FM_IRQHANDLER IRQHandler);
 void ym2610_reset(void);
-void ym2610_update(int length);
+void ym2610_update(int16_t *buffer, int length);	// stereo interleaved samples
 int ym2610_write(int addr, uint8_t value);
 uint8_t ym2610_read(int addr);
 int ym2610_timerOver(int channel);
+void ym2610_skip_silent(bool enabled);	// faster, but the skipped voices lose their phase
 
 typedef int16_t FMSAMPLE;
 
@@ -30,6 +32,5 @@ typedef int16_t FMSAMPLE;
  */
 extern double ym2610_fm_get_time_now(void);
 extern void ym2610_update_request(void);
-extern void ym2610_update_audio_buffer(FMSAMPLE lt, FMSAMPLE rt);
 
 #endif /* _YM2610_H_ */
@@ -1283,17 +1283,14 @@ void ssg_write(SSG *device, int addr, uint8_t data) {
 	ay8910_write_ym(device, addr, data);
 }
 
-void ssg_set_clock(SSG *device, int clock) {
-//	device->m_step = 8000000 / clock;
-	printf("*** TODO: SSG set clock %i -> step %i \n", clock, device->m_step);
+void ssg_set_clock(SSG *device, int clock, double rate) {
+	// The generators tick at clock / 16: 2.25 times per FM sample at the native rate
+	device->m_quarter_ticks = (int)(clock / 16 * 4 / rate + 0.5);
+	device->m_tick_fraction = 0;
 }
 
-int32_t ssg_update_one_sample(SSG *device) {
-	int32_t output[3] = {0, 0, 0};
-	int32_t* ref1[1] = {output};
-	
+void ssg_update(SSG *device, int32_t *buffer, int length) {
 	/*
-	 Ugly hack
 	 Data from Mame:
 	 SSG rate = SSG_Clock/8 (2MHz / 8)
 	 FM rate = FM_Clock/72 (8 MHz / 72)
@@ -1301,14 +1298,135 @@ int32_t ssg_update_one_sample(SSG *device) {
 	 1 YM FM sample = 2.25 SSG samples ...
 	 Mame is using 2 speparated audio stream, not me ;(
 	 */
-	static uint8_t toggleMore = 0;
-	
-	int samples = toggleMore == 3 ? 3 : 2;
-	sound_stream_update(device, ref1, samples);
+	int32_t output[SSG_UPDATE_MAX_LENGTH * 3];
+	int32_t* ref1[1] = {output};
+	const int max_block = SSG_UPDATE_MAX_LENGTH * 3 * 4 / (device->m_quarter_ticks + 3);
 	
-	toggleMore++;
-	if (toggleMore > 3) toggleMore = 0;
+	while (length > 0) {
+		int block = length < max_block ? length : max_block;
+		
+		// All the SSG samples of the block at once, then averaged by FM sample
+		int ssg_samples = 0;
+		int fraction = device->m_tick_fraction;
+		for (int i = 0; i < block; i++) {
+			fraction += device->m_quarter_ticks;
+			ssg_samples += fraction >> 2;
+			fraction &= 3;
+		}
+		sound_stream_update(device, ref1, ssg_samples);
+		
+		const int32_t *output_p = output;
+		for (int i = 0; i < block; i++) {
+			device->m_tick_fraction += device->m_quarter_ticks;
+			int count = device->m_tick_fraction >> 2;
+			device->m_tick_fraction &= 3;
+			int32_t sum = 0;
+			for (int j = 0; j < count; j++) {
+				sum += output_p[j];
+			}
+			buffer[i] = sum / count;
+			output_p += count;
+		}
+		
+		buffer += block;
+		length -= block;
+	}
+}
+
+// Without volume nor envelope the output doesn't depend on the generators
+static bool ssg_is_muted(SSG *device) {
+	for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+		if (device->m_regs[AY_AVOL + chan] != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool ssg_update_muted(SSG *device, int32_t *buffer, int length) {
+	if (!ssg_is_muted(device)) {
+		return false;
+	}
 	
-	return (output[0] + output[1] + output[2]) / samples;
+	const int32_t level = device->m_vol3d_table[0];
+	for (int i = 0; i < length; i++) {
+		buffer[i] = level;
+	}
+	return true;
+}
+
+// Advances a counter reset when it reaches its period, returns how many times it was
+static int ssg_skip_counter(int32_t *count, int period, int ticks) {
+	if (period < 1) {
+		period = 1;		// reached on every tick
+	}
+	int first = *count + 1 >= period ? 1 : period - *count;
+	if (ticks < first) {
+		*count += ticks;
+		return 0;
+	}
+	ticks -= first;
+	*count = ticks % period;
+	return 1 + ticks / period;
 }
 
+bool ssg_skip_muted(SSG *device, int length, int32_t *level) {
+	if (!ssg_is_muted(device)) {
+		return false;
+	}
+	
+	// The generator ticks sound_stream_update() would have run, see ssg_update()
+	int ticks = 0;
+	for (int i = 0; i < length; i++) {
+		device->m_tick_fraction += device->m_quarter_ticks;
+		ticks += device->m_tick_fraction >> 2;
+		device->m_tick_fraction &= 3;
+	}
+	
+	for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+		device->m_output[chan] ^= ssg_skip_counter(&device->m_count[chan], TONE_PERIOD(chan), ticks) & 1;
+	}
+	
+	// The random generator shifts when the noise prescaler goes to 1
+	int toggles = ssg_skip_counter(&device->m_count_noise, NOISE_PERIOD(), ticks);
+	int shifts = device->m_prescale_noise ? toggles / 2 : (toggles + 1) / 2;
+	device->m_prescale_noise ^= toggles & 1;
+	while (shifts--) {
+		device->m_rng ^= (((device->m_rng & 1) ^ ((device->m_rng >> 3) & 1)) << 17);
+		device->m_rng >>= 1;
+	}
+	
+	if (ticks == 0) {
+		*level = device->m_vol3d_table[0];
+		return true;
+	}
+	
+	for (int chan = 0; chan < NUM_CHANNELS; chan++) {
+		device->m_vol_enabled[chan] = (device->m_output[chan] | TONE_ENABLEQ(chan)) & (NOISE_OUTPUT() | NOISE_ENABLEQ(chan));
+	}
+	
+	if (device->m_holding == 0) {
+		int steps = ssg_skip_counter(&device->m_count_env, ENVELOPE_PERIOD() * device->m_step, ticks);
+		while (steps-- && device->m_holding == 0) {
+			device->m_env_step--;
+			if (device->m_env_step < 0) {
+				if (device->m_hold) {
+					if (device->m_alternate)
+						device->m_attack ^= device->m_env_step_mask;
+					device->m_holding = 1;
+					device->m_env_step = 0;
+					device->m_count_env = 0;	// stopped on that step
+				}
+				else {
+					if (device->m_alternate && (device->m_env_step & (device->m_env_step_mask + 1)))
+						device->m_attack ^= device->m_env_step_mask;
+					device->m_env_step &= device->m_env_step_mask;
+				}
+			}
+		}
+	}
+	device->m_env_volume = (device->m_env_step ^ device->m_attack);
+	
+	*level = device->m_vol3d_table[0];
+	return true;
+}
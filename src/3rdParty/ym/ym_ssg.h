@@ -92,6 +92,8 @@ typedef struct {
 	uint8_t m_env_step_mask;
 	/* init parameters ... */
 	int m_step;
+	int m_quarter_ticks;	/* generator ticks per FM sample, in quarters */
+	int m_tick_fraction;
 	int m_zero_is_off;
 	uint8_t m_vol_enabled[NUM_CHANNELS];
 	const ay_ym_param *m_par;
@@ -111,8 +113,11 @@ void ssg_init(SSG *device);
 void ssg_reset(SSG *device);
 uint8_t ssg_read(SSG *device);
 void ssg_write(SSG *device, int addr, uint8_t data);
-void ssg_set_clock(SSG *device, int clock);
-int32_t ssg_update_one_sample(SSG *device);
+void ssg_set_clock(SSG *device, int clock, double rate);	// rate of the FM samples
+#define SSG_UPDATE_MAX_LENGTH	256		// FM samples per sound_stream_update() call
+void ssg_update(SSG *device, int32_t *buffer, int length);	// one sample per FM sample
+bool ssg_update_muted(SSG *device, int32_t *buffer, int length);	// fills the buffer only when the 3 volumes are 0
+bool ssg_skip_muted(SSG *device, int length, int32_t *level);	// same state as ssg_update() when the 3 volumes are 0, without output
 
 extern void ssg_needs_update(void);
 
@@ -210,6 +210,7 @@ enum {
 #define HALT Z80.halt
 
 static int z80_ICount;
+static int z80_initial_cycles;
 Z80_Regs Z80;
 static Uint32 EA;
 
@@ -3534,6 +3535,7 @@ void z80_exit(void)
 int z80_execute(int cycles)
 {
 	z80_ICount = cycles;
+	z80_initial_cycles = cycles;
 
 	/* check for NMIs on the way in; they can only be set externally */
 	/* via timers, and can't be dynamically enabled, so it is safe */
@@ -3565,7 +3567,24 @@ int z80_execute(int cycles)
 		EXEC_INLINE(op,ROP());
 	} while( z80_ICount > 0 );
 
-	return cycles - z80_ICount;
+	return z80_initial_cycles - z80_ICount;
+}
+
+/****************************************************************************
+ * Number of cycles run so far in the current z80_execute() call
+ ****************************************************************************/
+int z80_cycles_run(void)
+{
+	return z80_initial_cycles - z80_ICount;
+}
+
+/****************************************************************************
+ * Change the length of the current z80_execute() call
+ ****************************************************************************/
+void z80_modify_timeslice(int cycles)
+{
+	z80_initial_cycles += cycles;
+	z80_ICount += cycles;
 }
 
 /****************************************************************************
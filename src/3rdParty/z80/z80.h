@@ -58,6 +58,8 @@ void z80_init ( int index, int clock, const void *config, int ( *irqcallback ) (
 void z80_reset ( void );
 void z80_exit ( void );
 int  z80_execute ( int cycles );
+int  z80_cycles_run ( void );
+void z80_modify_timeslice ( int cycles );
 void z80_set_irq_line ( int irqline, int state );
 
 #ifdef ENABLE_DEBUGGER
@@ -0,0 +1,191 @@
+#include "audio_resampler.h"
+#include "log.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define AUDIO_RESAMPLER_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define AUDIO_RESAMPLER_NEON
+#include <arm_neon.h>
+#endif
+
+#define RESAMPLER_TAPS			64		// filter length, multiple of 4
+#define RESAMPLER_PHASE_BITS	8
+#define RESAMPLER_PHASES		(1 << RESAMPLER_PHASE_BITS)	// linearly interpolated in between
+#define RESAMPLER_CHUNK			1024	// input frames converted at once
+#define RESAMPLER_KAISER_BETA	7.0		// about 70 dB of stop band
+#define RESAMPLER_BANDWIDTH		0.92	// part of the lowest Nyquist frequency in the pass band
+
+/// One filter per phase, plus the first one delayed by a frame to interpolate the last phase
+static float filter[RESAMPLER_PHASES + 1][RESAMPLER_TAPS];
+static double filter_cutoff;			// in cycles per input frame
+
+/// Deinterleaved input frames, from the first one still needed
+static float history[2][RESAMPLER_TAPS + RESAMPLER_CHUNK];
+static uint32_t history_frames;
+
+/// 32.32 fixed point input frame of the next output, the filter window starting there
+static uint64_t position;
+static uint64_t step;
+
+#pragma mark - Filter
+
+static double bessel_i0(double x) {
+	double sum = 1;
+	double term = 1;
+	for (int k = 1; k < 32; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+static void design_filter(double cutoff) {
+	const double center = RESAMPLER_TAPS / 2 - 1;
+	const double window_scale = 1.0 / bessel_i0(RESAMPLER_KAISER_BETA);
+
+	for (int phase = 0; phase <= RESAMPLER_PHASES; phase++) {
+		double coefficients[RESAMPLER_TAPS];
+		double sum = 0;
+		for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+			// Distance to the output time, in input frames
+			double t = tap - center - (double)phase / RESAMPLER_PHASES;
+			double x = 2 * t / RESAMPLER_TAPS;
+			double window = fabs(x) < 1 ? bessel_i0(RESAMPLER_KAISER_BETA * sqrt(1 - x * x)) * window_scale : 0;
+			double sinc = t == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+			coefficients[tap] = sinc * window;
+			sum += coefficients[tap];
+		}
+		// Unity gain on every phase, no ripple from the phase quantization
+		for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+			filter[phase][tap] = (float)(coefficients[tap] / sum);
+		}
+	}
+	filter_cutoff = cutoff;
+	LOG(LOG_DEBUG, "audio_resampler: filter cutoff %.3f\n", cutoff);
+}
+
+#pragma mark - Kernels
+
+/*
+ *	Both channels through the filter of the frame fraction, interpolated between two phases
+ */
+static inline void filter_frame(const float *left, const float *right, const float *coefficients, const float *next_coefficients, float weight, float *out_left, float *out_right) {
+#if defined(AUDIO_RESAMPLER_SSE2)
+	__m128 weights = _mm_set1_ps(weight);
+	__m128 left_sums = _mm_setzero_ps();
+	__m128 right_sums = _mm_setzero_ps();
+	for (int tap = 0; tap < RESAMPLER_TAPS; tap += 4) {
+		__m128 c0 = _mm_loadu_ps(coefficients + tap);
+		__m128 c = _mm_add_ps(c0, _mm_mul_ps(weights, _mm_sub_ps(_mm_loadu_ps(next_coefficients + tap), c0)));
+		left_sums = _mm_add_ps(left_sums, _mm_mul_ps(c, _mm_loadu_ps(left + tap)));
+		right_sums = _mm_add_ps(right_sums, _mm_mul_ps(c, _mm_loadu_ps(right + tap)));
+	}
+	// Left in lane 0, right in lane 1
+	__m128 sums = _mm_add_ps(_mm_unpacklo_ps(left_sums, right_sums), _mm_unpackhi_ps(left_sums, right_sums));
+	sums = _mm_add_ps(sums, _mm_movehl_ps(sums, sums));
+	*out_left = _mm_cvtss_f32(sums);
+	*out_right = _mm_cvtss_f32(_mm_shuffle_ps(sums, sums, 1));
+#elif defined(AUDIO_RESAMPLER_NEON)
+	float32x4_t left_sums = vdupq_n_f32(0);
+	float32x4_t right_sums = vdupq_n_f32(0);
+	for (int tap = 0; tap < RESAMPLER_TAPS; tap += 4) {
+		float32x4_t c0 = vld1q_f32(coefficients + tap);
+		float32x4_t c = vmlaq_n_f32(c0, vsubq_f32(vld1q_f32(next_coefficients + tap), c0), weight);
+		left_sums = vmlaq_f32(left_sums, c, vld1q_f32(left + tap));
+		right_sums = vmlaq_f32(right_sums, c, vld1q_f32(right + tap));
+	}
+	float32x2_t sums = vpadd_f32(vadd_f32(vget_low_f32(left_sums), vget_high_f32(left_sums)),
+								 vadd_f32(vget_low_f32(right_sums), vget_high_f32(right_sums)));
+	*out_left = vget_lane_f32(sums, 0);
+	*out_right = vget_lane_f32(sums, 1);
+#else
+	float left_sum = 0;
+	float right_sum = 0;
+	for (int tap = 0; tap < RESAMPLER_TAPS; tap++) {
+		float c = coefficients[tap] + weight * (next_coefficients[tap] - coefficients[tap]);
+		left_sum += c * left[tap];
+		right_sum += c * right[tap];
+	}
+	*out_left = left_sum;
+	*out_right = right_sum;
+#endif
+}
+
+static inline int16_t float_to_sample(float value) {
+	if (value >= 32767.0f) {
+		return 32767;
+	}
+	if (value <= -32768.0f) {
+		return -32768;
+	}
+	return (int16_t)lrintf(value);
+}
+
+#pragma mark - Public
+
+void audio_resampler_set_rates(double input_rate, double output_rate) {
+	step = (uint64_t)llround(input_rate / output_rate * 4294967296.0);
+
+	// Nearby rates keep the current filter, it is only designed again for a different cutoff
+	double cutoff = 0.5 * (output_rate < input_rate ? output_rate / input_rate : 1.0) * RESAMPLER_BANDWIDTH;
+	if (fabs(cutoff - filter_cutoff) > filter_cutoff * 0.01) {
+		design_filter(cutoff);
+	}
+}
+
+void audio_resampler_reset(void) {
+	memset(history, 0, sizeof(history));
+	// Silence up to the filter center, the first input frame is the first output one
+	history_frames = RESAMPLER_TAPS / 2 - 1;
+	position = 0;
+}
+
+uint32_t audio_resampler_process(const int16_t *input, uint32_t input_frames, int16_t *output, uint32_t max_output_frames) {
+	uint32_t output_frames = 0;
+	while (input_frames > 0) {
+		uint32_t count = RESAMPLER_TAPS + RESAMPLER_CHUNK - history_frames;
+		if (count > input_frames) {
+			count = input_frames;
+		}
+		if (count == 0) {
+			LOG(LOG_ERROR, "audio_resampler_process: output full, dropping %u frames\n", input_frames);
+			break;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			history[0][history_frames + i] = input[2 * i];
+			history[1][history_frames + i] = input[2 * i + 1];
+		}
+		history_frames += count;
+		input += 2 * count;
+		input_frames -= count;
+
+		// Every output whose filter window is complete
+		while (output_frames < max_output_frames && (position >> 32) + RESAMPLER_TAPS <= history_frames) {
+			uint32_t first = (uint32_t)(position >> 32);
+			uint32_t fraction = (uint32_t)position;
+			uint32_t phase = fraction >> (32 - RESAMPLER_PHASE_BITS);
+			float weight = (float)(fraction & ((1u << (32 - RESAMPLER_PHASE_BITS)) - 1)) * (1.0f / (1u << (32 - RESAMPLER_PHASE_BITS)));
+			float left, right;
+			filter_frame(&history[0][first], &history[1][first], filter[phase], filter[phase + 1], weight, &left, &right);
+			output[2 * output_frames] = float_to_sample(left);
+			output[2 * output_frames + 1] = float_to_sample(right);
+			output_frames++;
+			position += step;
+		}
+
+		// Drops the frames before the next window
+		uint32_t consumed = (uint32_t)(position >> 32);
+		if (consumed > history_frames) {
+			consumed = history_frames;
+		}
+		memmove(history[0], history[0] + consumed, (history_frames - consumed) * sizeof(float));
+		memmove(history[1], history[1] + consumed, (history_frames - consumed) * sizeof(float));
+		history_frames -= consumed;
+		position -= (uint64_t)consumed << 32;
+	}
+	return output_frames;
+}
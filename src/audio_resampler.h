@@ -0,0 +1,13 @@
+#ifndef audio_resampler_h
+#define audio_resampler_h
+
+#include <stdint.h>
+
+// Stereo band-limited resampler (windowed sinc polyphase filter) for any rates ratio
+void audio_resampler_set_rates(double input_rate, double output_rate);	// keeps the history: an output rate change does not click
+void audio_resampler_reset(void);
+
+// Returns how many frames were written, at most max_output_frames
+uint32_t audio_resampler_process(const int16_t *input, uint32_t input_frames, int16_t *output, uint32_t max_output_frames);
+
+#endif /* audio_resampler_h */
@@ -3,36 +3,84 @@
 #include "common_tools.h"
 #include "log.h"
 #include "memory_mapping.h"
+#include "neogeo.h"
+#include "rom_cache.h"
 #include "rom_region.h"
 
 #include "3rdParty/miniz/miniz.h"
 
+#include <pthread.h>
 #include <string.h>
+#include <unistd.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
 
 // Cartridge ROMS - https://wiki.neogeodev.org/index.php?title=Cartridges
 
 typedef struct cartridge {
-	rom_region_t p_roms[4];		// 68K programs
+	rom_region_t p_roms[5];		// 68K programs: P1 + up to 4 switchable banks
 	rom_region_t c_roms[8];		// Sprites tiles
 	rom_region_t s_roms[2];		// Fix sprite tiles
 	rom_region_t m1_rom;		// Z80 program
-	rom_region_t v1_roms[4];	// Sound samples
-	rom_region_t v2_roms[4];	// Sound samples
 } cartridge_t;
 
+typedef enum cartridge_rom_kind {
+	ROM_KIND_NONE,
+	ROM_KIND_P,
+	ROM_KIND_S,
+	ROM_KIND_C,
+	ROM_KIND_M1,
+	ROM_KIND_V1,				// Sound samples, PCM A
+	ROM_KIND_V2,				// Sound samples, PCM B
+} cartridge_rom_kind_t;
+
 
 cartridge_t plugged_cartridge;
 memory_region_t p_rom_bank1;
 memory_region_t p_rom_bank2;
 memory_region_t serialized_c_roms;
+uint32_t *characters_lines_usage = NULL;
 memory_region_t m1_rom;
 
+static rom_region_t p_rom_banks;		// switchable banks, contiguous ROM_BANK1_SIZE each
+static uint8_t *p_rom_empty_bank;		// zero filled bank for missing ones
+static rom_region_t pcm_roms[2];		// V1 then V2 ROMs, concatenated
+static rom_cache_t rom_cache;			// when mapped, ROM regions point into it
+static rom_region_t zip_mapping;		// game zip mapped during the load, for its stored entries
+
+#define ZIP_LOCAL_HEADER_SIGNATURE		0x04034b50
+#define ZIP_LOCAL_HEADER_SIZE			30
+#define ZIP_LOCAL_HEADER_NAME_LENGTH	26
+#define ZIP_LOCAL_HEADER_EXTRA_LENGTH	28
+
+static inline bool cartridge_is_zip_mapped(const uint8_t *data) {
+	return data != NULL && zip_mapping.data != NULL && data >= zip_mapping.data && data < zip_mapping.data + zip_mapping.size;
+}
+
 static void init_cartridge_p_rom(void);
 static void init_cartridge_p_rom2(void);
 static void init_cartridge_m1_rom(void);
 static uint16_t cartridge_game_ngh(void);
 static bool cartridge_p_rom_check(void);
-static void cartridge_serialize_c_rom(void);
+static bool cartridge_serialize_c_rom(mz_zip_archive *zip_archive);
+static cartridge_rom_kind_t cartridge_rom_kind(const char *file_name, uint8_t *index);
+static void cartridge_add_p_rom(uint8_t index, uint8_t *p, size_t pSize);
+static bool cartridge_extract_c_rom(mz_zip_archive *zip_archive, mz_uint file_index, rom_region_t *c_rom);
+static void cartridge_free_c_roms(void);
+static bool cartridge_create_pcm_roms(mz_zip_archive *zip_archive);
+static void cartridge_map_zip(const char *path);
+static void cartridge_unmap_zip(void);
+static bool cartridge_abort_load(mz_zip_archive *zip_archive);
+static uint32_t cartridge_zip_key(mz_zip_archive *zip_archive);
+static bool cartridge_load_cache(const char *path, uint32_t key);
+static void cartridge_save_cache(const char *path, uint32_t key);
+static void cartridge_plug(void);
+static void cartridge_create_p_rom_banks(void);
+static void cartridge_use_p_rom_bank(uint8_t bank);
 
 #pragma mark - Public
 
@@ -45,6 +93,10 @@ void cartridge_init() {
 }
 
 bool cartridge_load_roms(const char *path) {
+	if (cartridge_plugged_in()) {
+		cartridge_unload();
+	}
+	
 	mz_zip_archive zip_archive;
 	mz_zip_zero_struct(&zip_archive);
 	mz_bool status = mz_zip_reader_init_file(&zip_archive, path, 0);
@@ -52,6 +104,13 @@ bool cartridge_load_roms(const char *path) {
 		LOG(LOG_ERROR, "cartridge_load_roms: can't open game file at %s - %s \n", path, mz_zip_get_error_string(zip_archive.m_last_error));
 		return false;
 	}
+	
+	uint32_t cache_key = cartridge_zip_key(&zip_archive);
+	if (rom_cache_enabled() && cartridge_load_cache(path, cache_key)) {
+		mz_zip_reader_end(&zip_archive);
+		cartridge_plug();
+		return true;
+	}
 		
 	mz_uint files_count = mz_zip_reader_get_num_files(&zip_archive);
 	
@@ -59,274 +118,142 @@ bool cartridge_load_roms(const char *path) {
 		char file_name[128];
 		mz_zip_reader_get_filename(&zip_archive, file_index, file_name, 128);
 		
+		uint8_t i = 0;
+		cartridge_rom_kind_t kind = cartridge_rom_kind(file_name, &i);
+		if (kind == ROM_KIND_NONE) {
+			LOG(LOG_DEBUG, "cartridge_load_roms: unused file %s\n", file_name);
+			continue;
+		}
+		if (kind == ROM_KIND_C || kind == ROM_KIND_V1 || kind == ROM_KIND_V2) {
+			// Extracted on their own afterwards
+			continue;
+		}
+		
 		void *p;
 		size_t pSize;
 		p = mz_zip_reader_extract_to_heap(&zip_archive, file_index, &pSize, MZ_ZIP_FLAG_IGNORE_PATH);
 		if (!p) {
 			LOG(LOG_ERROR, "cartridge_load_roms: can't extract game rom file %s\n", file_name);
-			mz_zip_reader_end(&zip_archive);
-			return false;
+			return cartridge_abort_load(&zip_archive);
 		}
 		
-		bool found = false;
-		//P_ROM
-		for (uint8_t i = 1; i <= 2; i++) {
-			char element[4];
-			sprintf(element, "p%d.", i);
-			if (strcasestr(file_name, element) != NULL) {
+		switch (kind) {
+			case ROM_KIND_P:
 				LOG(LOG_DEBUG, "cartridge_load_roms found P_ROM %d %s - loaded at %p\n", i, file_name, p);
-				void *prom = p;
-				size_t prom_size = pSize;
-				if (prom_size > ROM_BANK1_SIZE) {
-					LOG(LOG_ERROR, "cartridge_load_roms P_ROM is too big: splitting\n");
-					// why MAME, why???
-					if (i == 1)
-					{
-						uint32_t offset = ROM_BANK1_SIZE;
-						if (prom_size == 2 * ROM_BANK1_SIZE) {
-							prom_size = pSize - offset;
-							prom = malloc(prom_size);
-							memcpy(prom, p + offset, prom_size);
-							
-							void *prom_2 = malloc(ROM_BANK1_SIZE);
-							memcpy(prom_2, p, ROM_BANK1_SIZE);
-							byte_swap_p_rom_if_needed(prom_2, ROM_BANK1_SIZE);
-							plugged_cartridge.p_roms[i].data = prom_2;
-							plugged_cartridge.p_roms[i].size = ROM_BANK1_SIZE;
-							free(p);
-							byte_swap_p_rom_if_needed(prom, prom_size);
-							plugged_cartridge.p_roms[i-1].data = prom;
-							plugged_cartridge.p_roms[i-1].size = prom_size;
-							found = true;
-							break;
-						}
-						else {
-							free(p);
-							break;
-						}
-					}
-					else
-					{
-						uint32_t offset = 0;
-						uint8_t rom_offset = 0;
-						while (offset < prom_size)
-						{
-							prom = malloc(ROM_BANK1_SIZE);
-							memcpy(prom, p + offset, ROM_BANK1_SIZE);
-							byte_swap_p_rom_if_needed(prom, ROM_BANK1_SIZE);
-							plugged_cartridge.p_roms[i-1 + rom_offset].data = prom;
-							plugged_cartridge.p_roms[i-1 + rom_offset].size = ROM_BANK1_SIZE;
-							offset += ROM_BANK1_SIZE;
-							rom_offset++;
-						}
-						found = true;
-						break;
-					}
-				}
-				else
-				{
-					byte_swap_p_rom_if_needed(prom, prom_size);
-					plugged_cartridge.p_roms[i-1].data = prom;
-					plugged_cartridge.p_roms[i-1].size = prom_size;
-					found = true;
-					break;
-				}
-			}
-		}
-		if (found == true) {
-			continue;
-		}
-		
-		//S_ROM
-		for (uint8_t i = 1; i <= 2; i++) {
-			char element[4];
-			sprintf(element, "s%d.", i);
-			if (strcasestr(file_name, element) != NULL) {
+				cartridge_add_p_rom(i, p, pSize);
+				break;
+			case ROM_KIND_S:
 				LOG(LOG_DEBUG, "cartridge_load_roms found S_ROM %d %s\n", i, file_name);
 				plugged_cartridge.s_roms[i-1].data = p;
 				plugged_cartridge.s_roms[i-1].size = pSize;
-				found = true;
 				break;
-			}
-		}
-		if (found == true) {
-			continue;
-		}
-		
-		//C_ROM
-		for (uint8_t i = 1; i <= 8; i++) {
-			char element[4];
-			sprintf(element, "c%d.", i);
-			if (strcasestr(file_name, element) != NULL) {
-				LOG(LOG_DEBUG, "cartridge_load_roms found C_ROM %d %s %lld bytes\n", i, file_name, pSize);
-				plugged_cartridge.c_roms[i-1].data = p;
-				plugged_cartridge.c_roms[i-1].size = pSize;
-				found = true;
+			default:
+				LOG(LOG_DEBUG, "cartridge_load_roms found M_ROM 1 %s %lld bytes\n", file_name, pSize);
+				plugged_cartridge.m1_rom.data = p;
+				plugged_cartridge.m1_rom.size = pSize;
 				break;
-			}
 		}
-		if (found == true) {
-			continue;
-		}
-		
-		// M ROM
-		if (strcasestr(file_name, "m1.") != NULL) {
-			LOG(LOG_DEBUG, "cartridge_load_roms found M_ROM 1 %s %lld bytes\n", file_name, pSize);
-			plugged_cartridge.m1_rom.data = p;
-			plugged_cartridge.m1_rom.size = pSize;
-			continue;
-		}
-		
-		//V1_ROM
-		if (strcasestr(file_name, "v1.") != NULL) {
-			LOG(LOG_DEBUG, "cartridge_load_roms found V1_ROM 1 %s %lld bytes\n", file_name, pSize);
-			plugged_cartridge.v1_roms[0].data = p;
-			plugged_cartridge.v1_roms[0].size = pSize;
-			continue;
-		}
-		
-		for (uint8_t i = 1; i <= 4; i++) {
-			char element[5];
-			sprintf(element, "v1%d.", i);
-			if (strcasestr(file_name, element) != NULL) {
-				LOG(LOG_DEBUG, "cartridge_load_roms found V1_ROM %d %s %lld bytes\n", i, file_name, pSize);
-				plugged_cartridge.v1_roms[i-1].data = p;
-				plugged_cartridge.v1_roms[i-1].size = pSize;
-				found = true;
-				break;
-			}
-		}
-		if (found == true) {
-			continue;
-		}
-		
-		//V2_ROM
-		if (strcasestr(file_name, "v2.") != NULL) {
-			LOG(LOG_DEBUG, "cartridge_load_roms found V2_ROM 1 %s %lld bytes\n", file_name, pSize);
-			plugged_cartridge.v2_roms[0].data = p;
-			plugged_cartridge.v2_roms[0].size = pSize;
-			continue;
-		}
-		
-		for (uint8_t i = 1; i <= 4; i++) {
-			char element[5];
-			sprintf(element, "v2%d.", i);
-			if (strcasestr(file_name, element) != NULL) {
-				LOG(LOG_DEBUG, "cartridge_load_roms found V2_ROM %d %s %lld bytes\n", i, file_name, pSize);
-				plugged_cartridge.v2_roms[i-1].data = p;
-				plugged_cartridge.v2_roms[i-1].size = pSize;
-				found = true;
-				break;
-			}
-		}
-		if (found == true) {
-			continue;
-		}
-		
-		// Nothing catched ?
-		mz_free(p);
-		LOG(LOG_DEBUG, "cartridge_load_roms: unused file %s\n", file_name);
 	}
 	
 	if (plugged_cartridge.p_roms[0].data == NULL
-		|| plugged_cartridge.s_roms[0].data == NULL
-		|| plugged_cartridge.c_roms[0].data == NULL
-		|| plugged_cartridge.c_roms[1].data == NULL) {
+		|| plugged_cartridge.s_roms[0].data == NULL) {
 		LOG(LOG_DEBUG, "cartridge_load_roms: seems that minimum roms are not found\n");
-		mz_zip_reader_end(&zip_archive);
-		return false;
+		return cartridge_abort_load(&zip_archive);
 	}
 	
 	if (cartridge_p_rom_check() == false) {
 		LOG(LOG_DEBUG, "cartridge_load_roms: P ROM header is missing NEO-GEO ref\n");
-		mz_zip_reader_end(&zip_archive);
-		return false;
+		return cartridge_abort_load(&zip_archive);
 	}
 	
+	// V ROMs are inflated straight into the PCM ROMs, C ROMs are serialized pair by pair
+	// and used in place when stored, to keep a single copy of the big ROMs in memory
+	cartridge_map_zip(path);
+	if (!cartridge_create_pcm_roms(&zip_archive) || !cartridge_serialize_c_rom(&zip_archive)) {
+		LOG(LOG_ERROR, "cartridge_load_roms: can't extract sound or sprites ROMs\n");
+		return cartridge_abort_load(&zip_archive);
+	}
+	cartridge_unmap_zip();
 	mz_zip_reader_end(&zip_archive);
 	
 	// Post treatment for internal architecture
 	
 	memset(p_rom_bank1.data, 0, ROM_BANK1_SIZE);
 	uint32_t p1Offset = 0;
-	for (int i = 0; i < 4; i++) {
+	for (int i = 0; i < 5; i++) {
 		if (plugged_cartridge.p_roms[i].data != NULL
 			&& p1Offset < ROM_BANK1_SIZE) {
-			memcpy(p_rom_bank1.data + p1Offset, plugged_cartridge.p_roms[i].data, plugged_cartridge.p_roms[i].size);
-			p1Offset += plugged_cartridge.p_roms[i].size;
+			size_t size = plugged_cartridge.p_roms[i].size;
+			if (size > ROM_BANK1_SIZE - p1Offset) {
+				size = ROM_BANK1_SIZE - p1Offset;
+			}
+			memcpy(p_rom_bank1.data + p1Offset, plugged_cartridge.p_roms[i].data, size);
+			p1Offset += size;
 		}
 	}
-	memset(p_rom_bank2.data, 0, ROM_BANK1_SIZE);
-	memcpy(p_rom_bank2.data, plugged_cartridge.p_roms[1].data, plugged_cartridge.p_roms[1].size);
-	
-	m1_rom.data = plugged_cartridge.m1_rom.data;
-	m1_rom.size = plugged_cartridge.m1_rom.size;
-	m1_rom.end_address = (uint32_t)m1_rom.size - 1;
+	cartridge_create_p_rom_banks();
 	
-	uint16_t ngh = cartridge_game_ngh();
-	LOG(LOG_INFO, "Cartridge NGH: %04d\n", ngh);
+	if (rom_cache_enabled()) {
+		cartridge_save_cache(path, cache_key);
+	}
 	
-	cartridge_serialize_c_rom();
+	cartridge_plug();
 	
 	return true;
 }
 
 void cartridge_unload(void) {
-	for (uint8_t i = 0; i < 2; i++) {
-		if (plugged_cartridge.p_roms[i].data != NULL) {
-			mz_free(plugged_cartridge.p_roms[i].data);
-		}
-		if (plugged_cartridge.s_roms[i].data != NULL) {
-			mz_free(plugged_cartridge.s_roms[i].data);
-			plugged_cartridge.s_roms[i].size = 0;
-		}
+	// P ROMs past the first one are only left when a load is aborted before banking them
+	for (uint8_t i = 0; i < 5; i++) {
+		mz_free(plugged_cartridge.p_roms[i].data);
+		plugged_cartridge.p_roms[i].data = NULL;
+		plugged_cartridge.p_roms[i].size = 0;
 	}
-	
+	cartridge_free_c_roms();
+	cartridge_unmap_zip();
 	memset(p_rom_bank1.data, 0, ROM_BANK1_SIZE);
-	memset(p_rom_bank2.data, 0, ROM_BANK1_SIZE);
-
-	for (uint8_t i = 0; i < 8; i++) {
-		if (plugged_cartridge.c_roms[i].data != NULL) {
-			mz_free(plugged_cartridge.c_roms[i].data);
-			plugged_cartridge.c_roms[i].size = 0;
+	
+	if (rom_cache.mapping == NULL) {
+		// Otherwise the regions are views of the cache mapping
+		free(p_rom_banks.data);
+		for (uint8_t i = 0; i < 2; i++) {
+			mz_free(plugged_cartridge.s_roms[i].data);
+			free(pcm_roms[i].data);
 		}
+		mz_free(plugged_cartridge.m1_rom.data);
+		free(serialized_c_roms.data);
+		free(characters_lines_usage);
 	}
+	rom_cache_release(&rom_cache);
 	
-	free(serialized_c_roms.data);
+	p_rom_banks.data = NULL;
+	p_rom_banks.size = 0;
+	p_rom_bank2.data = p_rom_empty_bank;
+	for (uint8_t i = 0; i < 2; i++) {
+		plugged_cartridge.s_roms[i].data = NULL;
+		plugged_cartridge.s_roms[i].size = 0;
+		pcm_roms[i].data = NULL;
+		pcm_roms[i].size = 0;
+	}
+	plugged_cartridge.m1_rom.data = NULL;
+	plugged_cartridge.m1_rom.size = 0;
+	m1_rom.data = NULL;
+	m1_rom.size = 0;
+	serialized_c_roms.data = NULL;
+	serialized_c_roms.size = 0;
+	characters_lines_usage = NULL;
 }
 
 bool cartridge_plugged_in() {
-	return plugged_cartridge.c_roms[0].data != NULL;
+	return serialized_c_roms.data != NULL;
 }
 
 rom_region_t * cartridge_get_first_fix_rom() {
 	return &plugged_cartridge.s_roms[0];
 }
 
-rom_region_t cartridge_create_pcm_rom(int index) {
-	rom_region_t *source = plugged_cartridge.v1_roms;
-	if (index > 0) {
-		source = plugged_cartridge.v2_roms;
-	}
-	rom_region_t result;
-	result.data = NULL;
-	result.size = 0;
-	for (int i = 0; i < 4; i++) {
-		if (source[i].data != NULL) {
-			result.size += source[i].size;
-		}
-	}
-	if (result.size > 0) {
-		result.data = malloc(result.size);
-		size_t offset = 0;
-		for (int i = 0; i < 4; i++) {
-			if (source[i].data != NULL) {
-				memcpy(result.data + offset, source[i].data, source[i].size);
-				offset += source[i].size;
-			}
-		}
-	}
-	return result;
+rom_region_t cartridge_get_pcm_rom(int index) {
+	return pcm_roms[index > 0 ? 1 : 0];
 }
 
 #pragma mark - Private
@@ -334,17 +261,17 @@ rom_region_t cartridge_create_pcm_rom(int index) {
 
 static uint8_t cartridge_p_rom_read_byte(uint32_t offset) {
 //	LOG(LOG_DEBUG, "cartridge_p_rom_read_byte 0x%08X\n", offset);
-	return p_rom_bank1.data[offset];
+	return p_rom_bank1.data[NATIVE_WORD_BYTE_OFFSET(offset)];
 }
 
 static uint16_t cartridge_p_rom_read_word(uint32_t offset) {
 //	LOG(LOG_DEBUG, "cartridge_p_rom_read_word 0x%08X\n", offset);
-	return BIG_ENDIAN_WORD(*((uint16_t *)(p_rom_bank1.data + offset)));
+	return *((uint16_t *)(p_rom_bank1.data + offset));
 }
 
 static uint32_t cartridge_p_rom_read_dword(uint32_t offset) {
 //	LOG(LOG_DEBUG, "cartridge_p_rom_read_dword 0x%08X\n", offset);
-	return BIG_ENDIAN_DWORD(*((uint32_t *)(p_rom_bank1.data + offset)));
+	return load_native_dword(p_rom_bank1.data + offset);
 }
 
 static void init_cartridge_p_rom() {
@@ -362,17 +289,17 @@ static void init_cartridge_p_rom() {
 
 static uint8_t cartridge_p_rom2_read_byte(uint32_t offset) {
 //	LOG(LOG_DEBUG, "cartridge_p_rom2_read_byte 0x%08X\n", offset);
-	return p_rom_bank2.data[offset];
+	return p_rom_bank2.data[NATIVE_WORD_BYTE_OFFSET(offset)];
 }
 
 static uint16_t cartridge_p_rom2_read_word(uint32_t offset) {
 //	LOG(LOG_DEBUG, "cartridge_p_rom2_read_word 0x%08X\n", offset);
-	return BIG_ENDIAN_WORD(*((uint16_t *)(p_rom_bank2.data + offset)));
+	return *((uint16_t *)(p_rom_bank2.data + offset));
 }
 
 static uint32_t cartridge_p_rom2_read_dword(uint32_t offset) {
 //	LOG(LOG_DEBUG, "cartridge_p_rom2_read_dword 0x%08X\n", offset);
-	return BIG_ENDIAN_DWORD(*((uint32_t *)(p_rom_bank2.data + offset)));
+	return load_native_dword(p_rom_bank2.data + offset);
 }
 
 static void cartridge_p_rom2_write_byte(uint32_t offset, uint8_t data) {
@@ -383,8 +310,7 @@ static void cartridge_p_rom2_write_byte(uint32_t offset, uint8_t data) {
 		case 2:
 		case 3:
 			LOG(LOG_DEBUG, "cartridge_p_rom2_write_byte bank switch #%u\n", data);
-			memset(p_rom_bank2.data, 0, ROM_BANK1_SIZE);
-			memcpy(p_rom_bank2.data, plugged_cartridge.p_roms[data+1].data, plugged_cartridge.p_roms[data+1].size);
+			cartridge_use_p_rom_bank(data);
 			break;
 		default:
 			LOG(LOG_DEBUG, "cartridge_p_rom2_write_byte unknown bank switch\n");
@@ -402,9 +328,53 @@ static void cartridge_p_rom2_write_dword(uint32_t offset, uint32_t data) {
 	cartridge_p_rom2_write_word(offset, data);
 }
 
+static void cartridge_create_p_rom_banks() {
+	free(p_rom_banks.data);
+	p_rom_banks.data = NULL;
+	p_rom_banks.size = 0;
+	
+	uint8_t banks_count = 0;
+	for (uint8_t i = 1; i < 5; i++) {
+		if (plugged_cartridge.p_roms[i].data != NULL) {
+			banks_count = i;
+		}
+	}
+	if (banks_count == 0) {
+		return;
+	}
+	
+	p_rom_banks.size = banks_count * ROM_BANK1_SIZE;
+	p_rom_banks.data = malloc(p_rom_banks.size);
+	memset(p_rom_banks.data, 0, p_rom_banks.size);
+	for (uint8_t i = 1; i <= banks_count; i++) {
+		rom_region_t *p_rom = &plugged_cartridge.p_roms[i];
+		if (p_rom->data == NULL) {
+			continue;
+		}
+		size_t size = p_rom->size < ROM_BANK1_SIZE ? p_rom->size : ROM_BANK1_SIZE;
+		memcpy(p_rom_banks.data + (i - 1) * ROM_BANK1_SIZE, p_rom->data, size);
+		mz_free(p_rom->data);
+		p_rom->data = NULL;
+		p_rom->size = 0;
+	}
+	LOG(LOG_DEBUG, "cartridge_create_p_rom_banks %u banks\n", banks_count);
+}
+
+static void cartridge_use_p_rom_bank(uint8_t bank) {
+	size_t offset = bank * ROM_BANK1_SIZE;
+	if (offset < p_rom_banks.size) {
+		p_rom_bank2.data = p_rom_banks.data + offset;
+	}
+	else {
+		p_rom_bank2.data = p_rom_empty_bank;
+	}
+	neogeo_map_p_rom_bank2();
+}
+
 static void init_cartridge_p_rom2() {
-	p_rom_bank2.data = malloc(ROM_BANK1_SIZE);
-	memset(p_rom_bank2.data, 0, ROM_BANK1_SIZE);
+	p_rom_empty_bank = malloc(ROM_BANK1_SIZE);
+	memset(p_rom_empty_bank, 0, ROM_BANK1_SIZE);
+	p_rom_bank2.data = p_rom_empty_bank;
 	p_rom_bank2.start_address = ROM_BANK2_START;
 	p_rom_bank2.end_address = ROM_BANK2_END;
 	p_rom_bank2.size = ROM_BANK1_SIZE;
@@ -443,8 +413,267 @@ static void init_cartridge_m1_rom() {
 	m1_rom.handlers.read_dword = &cartridge_m1_rom_read_dword;
 }
 
+#pragma mark V_ROMS
+
+/*
+ *	Concatenates V1 then V2 ROMs in the PCM ROMs, inflating each file at its final place
+ */
+static bool cartridge_create_pcm_roms(mz_zip_archive *zip_archive) {
+	mz_uint files[2][4];
+	size_t sizes[2][4];
+	memset(sizes, 0, sizeof(sizes));
+	
+	mz_uint files_count = mz_zip_reader_get_num_files(zip_archive);
+	for (mz_uint file_index = 0; file_index < files_count; file_index++) {
+		mz_zip_archive_file_stat file_stat;
+		if (!mz_zip_reader_file_stat(zip_archive, file_index, &file_stat)) {
+			continue;
+		}
+		uint8_t i = 0;
+		cartridge_rom_kind_t kind = cartridge_rom_kind(file_stat.m_filename, &i);
+		if (kind == ROM_KIND_V1 || kind == ROM_KIND_V2) {
+			uint8_t pcm_index = kind == ROM_KIND_V1 ? 0 : 1;
+			LOG(LOG_DEBUG, "cartridge_create_pcm_roms found V%d_ROM %d %s %lld bytes\n", pcm_index + 1, i, file_stat.m_filename, file_stat.m_uncomp_size);
+			files[pcm_index][i-1] = file_index;
+			sizes[pcm_index][i-1] = (size_t)file_stat.m_uncomp_size;
+		}
+	}
+	
+	for (int index = 0; index < 2; index++) {
+		rom_region_t *pcm_rom = &pcm_roms[index];
+		free(pcm_rom->data);
+		pcm_rom->data = NULL;
+		pcm_rom->size = 0;
+		for (int i = 0; i < 4; i++) {
+			pcm_rom->size += sizes[index][i];
+		}
+		if (pcm_rom->size == 0) {
+			continue;
+		}
+		
+		pcm_rom->data = malloc(pcm_rom->size);
+		size_t offset = 0;
+		for (int i = 0; i < 4; i++) {
+			if (sizes[index][i] == 0) {
+				continue;
+			}
+			if (!mz_zip_reader_extract_to_mem(zip_archive, files[index][i], pcm_rom->data + offset, sizes[index][i], 0)) {
+				LOG(LOG_ERROR, "cartridge_create_pcm_roms: can't extract V%d_ROM %d\n", index + 1, i + 1);
+				return false;
+			}
+			offset += sizes[index][i];
+		}
+	}
+	return true;
+}
+
+#pragma mark Zip
+
+/*
+ *	ROM type and number from its file name, 0 for V1 and V2 ROMs without number
+ */
+static cartridge_rom_kind_t cartridge_rom_kind(const char *file_name, uint8_t *index) {
+	char element[5];
+	for (uint8_t i = 1; i <= 2; i++) {
+		sprintf(element, "p%d.", i);
+		if (strcasestr(file_name, element) != NULL) {
+			*index = i;
+			return ROM_KIND_P;
+		}
+	}
+	for (uint8_t i = 1; i <= 2; i++) {
+		sprintf(element, "s%d.", i);
+		if (strcasestr(file_name, element) != NULL) {
+			*index = i;
+			return ROM_KIND_S;
+		}
+	}
+	for (uint8_t i = 1; i <= 8; i++) {
+		sprintf(element, "c%d.", i);
+		if (strcasestr(file_name, element) != NULL) {
+			*index = i;
+			return ROM_KIND_C;
+		}
+	}
+	if (strcasestr(file_name, "m1.") != NULL) {
+		*index = 1;
+		return ROM_KIND_M1;
+	}
+	for (uint8_t v = 1; v <= 2; v++) {
+		cartridge_rom_kind_t kind = v == 1 ? ROM_KIND_V1 : ROM_KIND_V2;
+		sprintf(element, "v%d.", v);
+		if (strcasestr(file_name, element) != NULL) {
+			*index = 1;
+			return kind;
+		}
+		for (uint8_t i = 1; i <= 4; i++) {
+			sprintf(element, "v%d%d.", v, i);
+			if (strcasestr(file_name, element) != NULL) {
+				*index = i;
+				return kind;
+			}
+		}
+	}
+	return ROM_KIND_NONE;
+}
+
+/*
+ *	Takes a P ROM extracted on heap, splitting the ones MAME sets in a single file
+ */
+static void cartridge_add_p_rom(uint8_t i, uint8_t *p, size_t pSize) {
+	if (pSize <= ROM_BANK1_SIZE) {
+		byte_swap_p_rom_if_needed(p, pSize);
+		plugged_cartridge.p_roms[i-1].data = p;
+		plugged_cartridge.p_roms[i-1].size = pSize;
+		return;
+	}
+	
+	LOG(LOG_ERROR, "cartridge_load_roms P_ROM is too big: splitting\n");
+	// why MAME, why???
+	if (i == 1) {
+		if (pSize == 2 * ROM_BANK1_SIZE) {
+			size_t prom_size = pSize - ROM_BANK1_SIZE;
+			uint8_t *prom = malloc(prom_size);
+			memcpy(prom, p + ROM_BANK1_SIZE, prom_size);
+			byte_swap_p_rom_if_needed(prom, prom_size);
+			plugged_cartridge.p_roms[i-1].data = prom;
+			plugged_cartridge.p_roms[i-1].size = prom_size;
+			
+			uint8_t *prom_2 = malloc(ROM_BANK1_SIZE);
+			memcpy(prom_2, p, ROM_BANK1_SIZE);
+			byte_swap_p_rom_if_needed(prom_2, ROM_BANK1_SIZE);
+			plugged_cartridge.p_roms[i].data = prom_2;
+			plugged_cartridge.p_roms[i].size = ROM_BANK1_SIZE;
+		}
+	}
+	else {
+		size_t offset = 0;
+		uint8_t rom_offset = 0;
+		while (offset < pSize && i-1 + rom_offset < 5) {
+			uint8_t *prom = malloc(ROM_BANK1_SIZE);
+			memset(prom, 0, ROM_BANK1_SIZE);
+			size_t size = pSize - offset < ROM_BANK1_SIZE ? pSize - offset : ROM_BANK1_SIZE;
+			memcpy(prom, p + offset, size);
+			byte_swap_p_rom_if_needed(prom, ROM_BANK1_SIZE);
+			plugged_cartridge.p_roms[i-1 + rom_offset].data = prom;
+			plugged_cartridge.p_roms[i-1 + rom_offset].size = ROM_BANK1_SIZE;
+			offset += ROM_BANK1_SIZE;
+			rom_offset++;
+		}
+	}
+	mz_free(p);
+}
+
+/*
+ *	Stored C ROMs are used in place from the zip mapping, others are inflated on heap
+ */
+static bool cartridge_extract_c_rom(mz_zip_archive *zip_archive, mz_uint file_index, rom_region_t *c_rom) {
+	if (c_rom->data != NULL && !cartridge_is_zip_mapped(c_rom->data)) {
+		mz_free(c_rom->data);
+	}
+	c_rom->data = NULL;
+	c_rom->size = 0;
+	
+	mz_zip_archive_file_stat file_stat;
+	if (zip_mapping.data != NULL
+		&& mz_zip_reader_file_stat(zip_archive, file_index, &file_stat)
+		&& file_stat.m_method == 0
+		&& !file_stat.m_is_encrypted
+		&& file_stat.m_comp_size == file_stat.m_uncomp_size) {
+		// Local header: signature, fixed fields, then file name and extra field of variable lengths
+		uint64_t header_offset = file_stat.m_local_header_ofs;
+		if (header_offset <= zip_mapping.size - ZIP_LOCAL_HEADER_SIZE) {
+			const uint8_t *header = zip_mapping.data + header_offset;
+			uint64_t data_offset = header_offset + ZIP_LOCAL_HEADER_SIZE
+								+ (header[ZIP_LOCAL_HEADER_NAME_LENGTH] | (header[ZIP_LOCAL_HEADER_NAME_LENGTH + 1] << 8))
+								+ (header[ZIP_LOCAL_HEADER_EXTRA_LENGTH] | (header[ZIP_LOCAL_HEADER_EXTRA_LENGTH + 1] << 8));
+			uint32_t signature = header[0] | (header[1] << 8) | (header[2] << 16) | ((uint32_t)header[3] << 24);
+			if (signature == ZIP_LOCAL_HEADER_SIGNATURE
+				&& data_offset <= zip_mapping.size
+				&& file_stat.m_uncomp_size <= zip_mapping.size - data_offset) {
+				c_rom->data = zip_mapping.data + data_offset;
+				c_rom->size = (size_t)file_stat.m_uncomp_size;
+				return true;
+			}
+		}
+	}
+	
+	size_t size;
+	c_rom->data = mz_zip_reader_extract_to_heap(zip_archive, file_index, &size, MZ_ZIP_FLAG_IGNORE_PATH);
+	c_rom->size = c_rom->data != NULL ? size : 0;
+	return c_rom->data != NULL;
+}
+
+static void cartridge_free_c_roms() {
+	for (uint8_t i = 0; i < 8; i++) {
+		rom_region_t *c_rom = &plugged_cartridge.c_roms[i];
+		if (!cartridge_is_zip_mapped(c_rom->data)) {
+			mz_free(c_rom->data);
+		}
+#if !defined(_WIN32) && defined(MADV_DONTNEED)
+		else {
+			// Drops the pages holding only this ROM, the range stays reserved until the whole zip is unmapped
+			uintptr_t page_mask = (uintptr_t)sysconf(_SC_PAGESIZE) - 1;
+			uintptr_t start = ((uintptr_t)c_rom->data + page_mask) & ~page_mask;
+			uintptr_t end = ((uintptr_t)c_rom->data + c_rom->size) & ~page_mask;
+			if (end > start) {
+				madvise((void *)start, end - start, MADV_DONTNEED);
+			}
+		}
+#endif
+		c_rom->data = NULL;
+		c_rom->size = 0;
+	}
+}
+
+static void cartridge_map_zip(const char *path) {
+	cartridge_unmap_zip();
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) == 0 && file_stat.st_size >= ZIP_LOCAL_HEADER_SIZE) {
+		void *data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (data != MAP_FAILED) {
+			zip_mapping.data = data;
+			zip_mapping.size = file_stat.st_size;
+		}
+	}
+	close(fd);
+#endif
+}
+
+static void cartridge_unmap_zip() {
+#ifndef _WIN32
+	if (zip_mapping.data != NULL) {
+		munmap(zip_mapping.data, zip_mapping.size);
+	}
+#endif
+	zip_mapping.data = NULL;
+	zip_mapping.size = 0;
+}
+
+static bool cartridge_abort_load(mz_zip_archive *zip_archive) {
+	cartridge_unload();
+	mz_zip_reader_end(zip_archive);
+	return false;
+}
+
 #pragma mark Util
 
+static void cartridge_plug() {
+	cartridge_use_p_rom_bank(0);
+	
+	m1_rom.data = plugged_cartridge.m1_rom.data;
+	m1_rom.size = plugged_cartridge.m1_rom.size;
+	m1_rom.end_address = (uint32_t)m1_rom.size - 1;
+	
+	uint16_t ngh = cartridge_game_ngh();
+	LOG(LOG_INFO, "Cartridge NGH: %04d\n", ngh);
+}
+
 static uint16_t cartridge_game_ngh() {
 	uint16_t bcd = p_rom_bank1.handlers.read_word(0x108);
 	LOG(LOG_DEBUG, "cartridge_game_ngh 0x%04X\n", bcd);
@@ -466,7 +695,7 @@ static bool cartridge_p_rom_check() {
 	p += 0x100;
 	char ref[8] = "NEO-GEO";
 	for (uint8_t i = 0; i < 7; ++i) {
-		char c = p[i];
+		char c = p[NATIVE_WORD_BYTE_OFFSET(i)];
 		if (ref[i] != c) {
 			return false;
 		}
@@ -479,21 +708,139 @@ static bool cartridge_p_rom_check() {
  *	Prepare all sprites to be easily displayed on framebuffer
  *	Unit data will be half byte pixel color index
  *	Each scanline is 8 bytes
+ *	Tiles are split in ranges serialized in parallel
  */
 
 static const uint8_t ROM_TILE_BLOCK_BYTES = 16;		// 16 bytes per block per rom ( x 4 blocks x 2 ROMs = 128 bytes per tile)
+#define SERIALIZE_MAX_THREADS	8
+
+typedef struct serialize_job {
+	const uint8_t *odd_data;		// planes 0 and 1
+	const uint8_t *even_data;		// planes 2 and 3
+	uint8_t *serialized_data;		// first tile of the ROMs pair
+	uint32_t *lines_usage;
+	size_t first_tile;
+	size_t last_tile;
+} serialize_job_t;
+
+static uint32_t plane_to_nibbles[256];	// bit n of a plane byte moved to bit 4 * n
+
+static void init_plane_to_nibbles(void) {
+	for (uint32_t plane = 0; plane < 256; plane++) {
+		uint32_t nibbles = 0;
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			nibbles |= ((plane >> bit) & 0x01) << (bit * 4);
+		}
+		plane_to_nibbles[plane] = nibbles;
+	}
+}
 
-static void cartridge_serialize_c_rom() {
+/*
+ *	Flags each serialized tile line as transparent, opaque or mixed,
+ *	2 bits per line, 16 lines per tile
+ */
+static uint32_t classify_tile_lines(const uint8_t *tile) {
+	uint32_t usage = 0;
+	for (uint8_t line = 0; line < CHARACTER_TILE_LINES; ++line) {
+		uint64_t pixels;
+		memcpy(&pixels, tile + line * 8, sizeof(pixels));
+		// Any zero nibble in the line (the classic has-zero-byte test, on nibbles)
+		bool has_transparent_pixel = ((pixels - 0x1111111111111111ULL) & ~pixels & 0x8888888888888888ULL) != 0;
+		
+		uint32_t line_usage = CHARACTER_LINE_MIXED;
+		if (pixels == 0) {
+			line_usage = CHARACTER_LINE_TRANSPARENT;
+		}
+		else if (!has_transparent_pixel) {
+			line_usage = CHARACTER_LINE_OPAQUE;
+		}
+		usage |= line_usage << (line * 2);
+	}
+	return usage;
+}
+
+static void *serialize_tiles(void *arg) {
+	const serialize_job_t *job = arg;
+	
+	for (size_t tile_index = job->first_tile; tile_index < job->last_tile; ++tile_index) {
+		const uint8_t *odd_tile_base = job->odd_data + (tile_index * CHARACTER_TILE_BYTES/2);
+		const uint8_t *even_tile_base = job->even_data + (tile_index * CHARACTER_TILE_BYTES/2);
+		uint8_t *tile_data = job->serialized_data + tile_index * CHARACTER_TILE_BYTES;
+		uint8_t *serialized_data_p = tile_data;
+		
+		for (uint8_t vertical_block_pass = 0; vertical_block_pass < 2; ++vertical_block_pass) {
+			// blocks 3/1 then 4/2
+			uint8_t left_block = 3 + vertical_block_pass;
+			uint8_t right_block = 1 + vertical_block_pass;
+			for (uint8_t scanline = 0; scanline < 8; scanline++) {
+				// 8 scanlines per block
+				for (uint8_t horizontal_block_pass = 0; horizontal_block_pass < 2; ++horizontal_block_pass) {
+					// draw left then right block
+					uint8_t block_index = horizontal_block_pass == 0 ? left_block - 1 : right_block - 1;
+					
+					const uint8_t *odd_block_base = odd_tile_base + (block_index * ROM_TILE_BLOCK_BYTES) + (scanline * 2);
+					const uint8_t *even_block_base = even_tile_base + (block_index * ROM_TILE_BLOCK_BYTES) + (scanline * 2);
+					
+					// 8 pixels, one bit of each plane per pixel, first pixel in the low nibble
+					uint32_t pixels = plane_to_nibbles[odd_block_base[0]]
+									| (plane_to_nibbles[odd_block_base[1]] << 1)
+									| (plane_to_nibbles[even_block_base[0]] << 2)
+									| (plane_to_nibbles[even_block_base[1]] << 3);
+					serialized_data_p[0] = (uint8_t)pixels;
+					serialized_data_p[1] = (uint8_t)(pixels >> 8);
+					serialized_data_p[2] = (uint8_t)(pixels >> 16);
+					serialized_data_p[3] = (uint8_t)(pixels >> 24);
+					serialized_data_p += 4;
+				}
+			}
+		}
+		
+		job->lines_usage[tile_index] = classify_tile_lines(tile_data);
+	}
+	return NULL;
+}
+
+static int serialize_threads_count(void) {
+	long count = 1;
+#ifdef _SC_NPROCESSORS_ONLN
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (count < 1) {
+		count = 1;
+	}
+	return count > SERIALIZE_MAX_THREADS ? SERIALIZE_MAX_THREADS : (int)count;
+}
+
+static bool cartridge_serialize_c_rom(mz_zip_archive *zip_archive) {
+	mz_uint files[8];
+	size_t sizes[8];
+	memset(sizes, 0, sizeof(sizes));
+	
+	mz_uint files_count = mz_zip_reader_get_num_files(zip_archive);
+	for (mz_uint file_index = 0; file_index < files_count; file_index++) {
+		mz_zip_archive_file_stat file_stat;
+		uint8_t i = 0;
+		if (mz_zip_reader_file_stat(zip_archive, file_index, &file_stat)
+			&& cartridge_rom_kind(file_stat.m_filename, &i) == ROM_KIND_C) {
+			LOG(LOG_DEBUG, "cartridge_serialize_c_rom found C_ROM %d %s %lld bytes\n", i, file_stat.m_filename, file_stat.m_uncomp_size);
+			files[i-1] = file_index;
+			sizes[i-1] = (size_t)file_stat.m_uncomp_size;
+		}
+	}
+	
 	size_t characters_ram_size = 0;
 	uint8_t rom_pairs_count = 0;
 	for (uint8_t i = 0; i < 8; i++) {
-		if (plugged_cartridge.c_roms[i].data != NULL) {
-			characters_ram_size += plugged_cartridge.c_roms[i].size;
+		if (sizes[i] > 0) {
+			characters_ram_size += sizes[i];
 			rom_pairs_count++;
 		}
 	}
 	
 	rom_pairs_count /= 2;
+	if (rom_pairs_count == 0) {
+		return false;
+	}
 	
 	if (serialized_c_roms.data != NULL) {
 		free(serialized_c_roms.data);
@@ -503,66 +850,133 @@ static void cartridge_serialize_c_rom() {
 	serialized_c_roms.size = characters_ram_size;
 	LOG(LOG_DEBUG, "cartridge_serialize_c_rom allocating %lld MB at %p\n", characters_ram_size / (1024*1024), serialized_c_roms.data);
 	
-	uint8_t *serialized_data_p = serialized_c_roms.data;
+	free(characters_lines_usage);
+	characters_lines_usage = malloc(characters_ram_size / CHARACTER_TILE_BYTES * sizeof(uint32_t));
+	
+	if (plane_to_nibbles[0xFF] == 0) {
+		init_plane_to_nibbles();
+	}
+	
+	int threads_count = serialize_threads_count();
+	size_t serialized_tiles = 0;
 	
 	for (uint8_t pair = 0; pair < rom_pairs_count; ++pair) {
 		LOG(LOG_DEBUG, "cartridge_serialize_c_rom serializing C ROM pair %u - %u\n", pair * 2 + 1, pair * 2 + 2);
-		uint8_t *odd_data = plugged_cartridge.c_roms[pair * 2].data;
-		uint8_t *even_data = plugged_cartridge.c_roms[pair * 2 + 1].data;
 		
-		size_t roms_size = plugged_cartridge.c_roms[pair * 2].size;
-		if (roms_size != plugged_cartridge.c_roms[pair * 2 + 1].size) {
+		size_t roms_size = sizes[pair * 2];
+		if (roms_size != sizes[pair * 2 + 1]) {
 			LOG(LOG_ERROR, "cartridge_serialize_c_rom %d and %d C ROMS are not even\n",  pair * 2 + 1, pair * 2 + 2);
 		}
+		if (roms_size == 0 || sizes[pair * 2 + 1] < roms_size) {
+			return false;
+		}
+		if (!cartridge_extract_c_rom(zip_archive, files[pair * 2], &plugged_cartridge.c_roms[pair * 2])
+			|| !cartridge_extract_c_rom(zip_archive, files[pair * 2 + 1], &plugged_cartridge.c_roms[pair * 2 + 1])) {
+			LOG(LOG_ERROR, "cartridge_serialize_c_rom can't extract C ROMS %d and %d\n",  pair * 2 + 1, pair * 2 + 2);
+			cartridge_free_c_roms();
+			return false;
+		}
 		
 		size_t tiles_to_serialize = roms_size * 2 / CHARACTER_TILE_BYTES;
-		LOG(LOG_DEBUG, "cartridge_serialize_c_rom will serializing %u tiles\n", tiles_to_serialize);
+		LOG(LOG_DEBUG, "cartridge_serialize_c_rom will serializing %u tiles on %d threads\n", tiles_to_serialize, threads_count);
 		
-		for (size_t tile_index = 0; tile_index < tiles_to_serialize; ++tile_index) {
-			uint8_t *odd_tile_base = odd_data + (tile_index * CHARACTER_TILE_BYTES/2);
-			uint8_t *even_tile_base = even_data + (tile_index * CHARACTER_TILE_BYTES/2);
-			
-			uint8_t left_block = 3;
-			uint8_t right_block = 1;
-			for (uint8_t vertical_block_pass = 0; vertical_block_pass < 2; ++vertical_block_pass) {
-				// blocks 3/1 then 4/2
-				left_block += vertical_block_pass;
-				right_block += vertical_block_pass;
-				for (uint8_t scanline = 0; scanline < 8; scanline++) {
-					// 8 scanlines per block
-					for (uint8_t horizontal_block_pass = 0; horizontal_block_pass < 2; ++horizontal_block_pass) {
-						// draw left then right block
-						uint8_t block_index = horizontal_block_pass == 0 ? left_block - 1 : right_block - 1;
-						
-						uint8_t *odd_left_block_base = odd_tile_base + (block_index * ROM_TILE_BLOCK_BYTES) + (scanline * 2);
-						uint8_t *even_left_block_base = even_tile_base + (block_index * ROM_TILE_BLOCK_BYTES) + (scanline * 2);
-						
-						uint8_t plane_0 = odd_left_block_base[0];
-						uint8_t plane_1 = odd_left_block_base[1];
-						uint8_t plane_2 = even_left_block_base[0];
-						uint8_t plane_3 = even_left_block_base[1];
-						
-						for (uint8_t row = 0; row < 8; row++) {
-							uint8_t pixel_color_index = 0;
-							pixel_color_index |= (plane_0 >> row) & 0x01;
-							pixel_color_index |= ((plane_1 >> row) & 0x01) << 1;
-							pixel_color_index |= ((plane_2 >> row) & 0x01) << 2;
-							pixel_color_index |= ((plane_3 >> row) & 0x01) << 3;
-							if (row & 1) {
-								*serialized_data_p |= pixel_color_index << 4;
-								++serialized_data_p;
-							}
-							else {
-								*serialized_data_p |= pixel_color_index;
-							}
-						}
-					}
-				}
+		serialize_job_t jobs[SERIALIZE_MAX_THREADS];
+		pthread_t threads[SERIALIZE_MAX_THREADS];
+		bool started[SERIALIZE_MAX_THREADS];
+		for (int i = 0; i < threads_count; i++) {
+			jobs[i].odd_data = plugged_cartridge.c_roms[pair * 2].data;
+			jobs[i].even_data = plugged_cartridge.c_roms[pair * 2 + 1].data;
+			jobs[i].serialized_data = serialized_c_roms.data + serialized_tiles * CHARACTER_TILE_BYTES;
+			jobs[i].lines_usage = characters_lines_usage + serialized_tiles;
+			jobs[i].first_tile = tiles_to_serialize * i / threads_count;
+			jobs[i].last_tile = tiles_to_serialize * (i + 1) / threads_count;
+			// The first range runs on this thread, as do the ones that could not get a thread
+			started[i] = i > 0 && pthread_create(&threads[i], NULL, serialize_tiles, &jobs[i]) == 0;
+		}
+		for (int i = 0; i < threads_count; i++) {
+			if (!started[i]) {
+				serialize_tiles(&jobs[i]);
 			}
 		}
+		for (int i = 1; i < threads_count; i++) {
+			if (started[i]) {
+				pthread_join(threads[i], NULL);
+			}
+		}
+		
+		serialized_tiles += tiles_to_serialize;
+		
+		// Only the serialized tiles are used from now on
+		cartridge_free_c_roms();
 	}
 	
-	uint64_t bytes = serialized_data_p - serialized_c_roms.data + 1;
-	uint64_t tiles_count = bytes / CHARACTER_TILE_BYTES;
-	LOG(LOG_DEBUG, "cartridge_serialize_c_rom parsed %u tiles\n", tiles_count);
+	LOG(LOG_DEBUG, "cartridge_serialize_c_rom parsed %u tiles\n", serialized_tiles);
+	return true;
+}
+
+#pragma mark ROM cache
+
+/*
+ *	Identifies the game zip contents from its central directory, without inflating anything
+ */
+static uint32_t cartridge_zip_key(mz_zip_archive *zip_archive) {
+	mz_ulong key = MZ_CRC32_INIT;
+	mz_uint files_count = mz_zip_reader_get_num_files(zip_archive);
+	for (mz_uint file_index = 0; file_index < files_count; file_index++) {
+		mz_zip_archive_file_stat file_stat;
+		if (!mz_zip_reader_file_stat(zip_archive, file_index, &file_stat)) {
+			continue;
+		}
+		uint32_t crc = file_stat.m_crc32;
+		uint64_t size = file_stat.m_uncomp_size;
+		key = mz_crc32(key, (const uint8_t *)file_stat.m_filename, strlen(file_stat.m_filename));
+		key = mz_crc32(key, (const uint8_t *)&crc, sizeof(crc));
+		key = mz_crc32(key, (const uint8_t *)&size, sizeof(size));
+	}
+	return (uint32_t)key;
+}
+
+static bool cartridge_load_cache(const char *path, uint32_t key) {
+	if (rom_cache_load(&rom_cache, path, key) == false) {
+		return false;
+	}
+	
+	const rom_region_t *sections = rom_cache.sections;
+	size_t tiles_count = sections[ROM_CACHE_SERIALIZED_C_ROMS].size / CHARACTER_TILE_BYTES;
+	if (sections[ROM_CACHE_P_ROM_BANK1].size != ROM_BANK1_SIZE
+		|| sections[ROM_CACHE_S_ROM].data == NULL
+		|| tiles_count == 0
+		|| sections[ROM_CACHE_CHARACTERS_LINES_USAGE].size != tiles_count * sizeof(uint32_t)) {
+		LOG(LOG_ERROR, "cartridge_load_cache: incomplete cache for %s\n", path);
+		rom_cache_release(&rom_cache);
+		return false;
+	}
+	
+	memcpy(p_rom_bank1.data, sections[ROM_CACHE_P_ROM_BANK1].data, ROM_BANK1_SIZE);
+	p_rom_banks = sections[ROM_CACHE_P_ROM_BANKS];
+	serialized_c_roms.data = sections[ROM_CACHE_SERIALIZED_C_ROMS].data;
+	serialized_c_roms.size = sections[ROM_CACHE_SERIALIZED_C_ROMS].size;
+	characters_lines_usage = (uint32_t *)sections[ROM_CACHE_CHARACTERS_LINES_USAGE].data;
+	plugged_cartridge.s_roms[0] = sections[ROM_CACHE_S_ROM];
+	plugged_cartridge.m1_rom = sections[ROM_CACHE_M1_ROM];
+	pcm_roms[0] = sections[ROM_CACHE_PCM_A];
+	pcm_roms[1] = sections[ROM_CACHE_PCM_B];
+	return true;
+}
+
+static void cartridge_save_cache(const char *path, uint32_t key) {
+	rom_cache_t cache;
+	memset(&cache, 0, sizeof(cache));
+	cache.sections[ROM_CACHE_P_ROM_BANK1].data = p_rom_bank1.data;
+	cache.sections[ROM_CACHE_P_ROM_BANK1].size = ROM_BANK1_SIZE;
+	cache.sections[ROM_CACHE_P_ROM_BANKS] = p_rom_banks;
+	cache.sections[ROM_CACHE_SERIALIZED_C_ROMS].data = serialized_c_roms.data;
+	cache.sections[ROM_CACHE_SERIALIZED_C_ROMS].size = serialized_c_roms.size;
+	cache.sections[ROM_CACHE_CHARACTERS_LINES_USAGE].data = (uint8_t *)characters_lines_usage;
+	cache.sections[ROM_CACHE_CHARACTERS_LINES_USAGE].size = serialized_c_roms.size / CHARACTER_TILE_BYTES * sizeof(uint32_t);
+	cache.sections[ROM_CACHE_S_ROM] = plugged_cartridge.s_roms[0];
+	cache.sections[ROM_CACHE_M1_ROM] = plugged_cartridge.m1_rom;
+	cache.sections[ROM_CACHE_PCM_A] = pcm_roms[0];
+	cache.sections[ROM_CACHE_PCM_B] = pcm_roms[1];
+	rom_cache_save(&cache, path, key);
 }
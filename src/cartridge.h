@@ -5,11 +5,17 @@
 #include "rom_region.h"
 
 static const uint8_t CHARACTER_TILE_BYTES = 128;
+static const uint8_t CHARACTER_TILE_LINES = 16;
+
+#define CHARACTER_LINE_MIXED		0
+#define CHARACTER_LINE_TRANSPARENT	1
+#define CHARACTER_LINE_OPAQUE		2
 
 extern memory_region_t p_rom_bank1;		// Init Vector table - https://wiki.neogeodev.org/index.php?title=68k_vector_table
 										// + program ROM - https://wiki.neogeodev.org/index.php?title=P_ROM
 extern memory_region_t p_rom_bank2;
 extern memory_region_t serialized_c_roms;	// serialized sprites from C ROMs ready for display, half byte per pixel
+extern uint32_t *characters_lines_usage;	// per serialized tile, 2 bits CHARACTER_LINE_* for each line
 
 extern memory_region_t m1_rom;	// Music ROM - https://wiki.neogeodev.org/index.php?title=M1_ROM
 
@@ -19,6 +25,6 @@ void cartridge_unload(void);
 bool cartridge_plugged_in(void);
 
 rom_region_t * cartridge_get_first_fix_rom(void);
-rom_region_t cartridge_create_pcm_rom(int index);
+rom_region_t cartridge_get_pcm_rom(int index);	// owned by the cartridge, V1 ROMs for index 0 then V2
 
 #endif /* cartridge_h */
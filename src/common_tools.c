@@ -9,7 +9,15 @@ void byte_swap_p_rom_if_needed(uint8_t * rom, size_t length)
 	uint32_t initVector0 = ((uint32_t*)rom)[0];
 	LOG(LOG_DEBUG, "P ROM init vector 0 0x%08X\n", initVector0);
 	
-	if (rom[1] != 0x10 && rom[2] != 0xF3) {
+	// 68K ROMs are kept in host native word order
+	bool is_big_endian = !(rom[1] != 0x10 && rom[2] != 0xF3);
+#ifdef BIG_ENDIAN_MACHINE
+	bool needs_swap = !is_big_endian;
+#else
+	bool needs_swap = is_big_endian;
+#endif
+	
+	if (needs_swap) {
 		LOG(LOG_DEBUG, "P ROM init vector needs byte swap\n");
 		// swap bytes in each word
 		for (i = 0; i < length - 1; i += 2) {
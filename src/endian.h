@@ -3,8 +3,10 @@
 
 #ifdef __cplusplus
     #include <cstdint>
+    #include <cstring>
 #else
     #include <stdint.h>
+    #include <string.h>
 #endif
 
 #if defined(__ppc__) || defined(__POWERPC__) || defined(_M_PPC)
@@ -57,4 +59,27 @@
     #define LITTLE_ENDIAN_DWORD(x) (x)
 #endif // LITTLE_ENDIAN_MACHINE
 
+// 68K memory is stored as host native words:
+// bytes offsets are flipped inside words on little endian machines
+// and dwords are loaded as two native words, high word first.
+#ifdef BIG_ENDIAN_MACHINE
+    #define NATIVE_WORD_BYTE_OFFSET(x) (x)
+    #define NATIVE_WORDS_DWORD(x) (x)
+#else
+    #define NATIVE_WORD_BYTE_OFFSET(x) ((x) ^ 1)
+    #define NATIVE_WORDS_DWORD(x) ((uint32_t)(((x) << 16) | ((x) >> 16)))
+#endif
+
+// 68K dwords are only word aligned: go through memcpy to stay portable
+static inline uint32_t load_native_dword(const uint8_t *data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return NATIVE_WORDS_DWORD(value);
+}
+
+static inline void store_native_dword(uint8_t *data, uint32_t value) {
+    value = NATIVE_WORDS_DWORD(value);
+    memcpy(data, &value, sizeof(value));
+}
+
 #endif // ENDIAN_H
@@ -1,21 +1,94 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "libretro.h"
 #include "cartridge.h"
 #include "libretro_core.h"
 #include "neogeo.h"
 #include "log.h"
+#include "rom_cache.h"
 #include "sound.h"
+#include "timer.h"
 #include "video.h"
+#include "video_kernels.h"
 
 #pragma mark - Properties
 
+static const struct retro_variable core_variables[] = {
+	{ "neogeo_rom_cache", "ROM cache (faster game loading, uses disk space); disabled|enabled" },
+	{ "neogeo_threaded_video", "Threaded video rendering (needs a spare CPU core); disabled|enabled" },
+	{ "neogeo_sample_rate", "Audio sample rate (Hz); 44100|48000|32000|96000" },
+	{ "neogeo_audio_quality", "Audio quality (for slow CPUs); full|half rate|skip silent" },
+	{ NULL, NULL }
+};
+
+static const char *core_option_value(const char *key) {
+	struct retro_variable variable = { key, NULL };
+	if (libretroCallbacks.environment(RETRO_ENVIRONMENT_GET_VARIABLE, &variable) == false) {
+		return NULL;
+	}
+	return variable.value;
+}
 
+static void update_rom_cache_directory(void) {
+	const char *value = core_option_value("neogeo_rom_cache");
+	if (value == NULL || strcmp(value, "enabled") != 0) {
+		rom_cache_set_directory(NULL);
+		return;
+	}
+	
+	const char *directory = NULL;
+	if (!libretroCallbacks.environment(RETRO_ENVIRONMENT_GET_SAVE_DIRECTORY, &directory) || directory == NULL) {
+		libretroCallbacks.environment(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &directory);
+	}
+	if (directory == NULL) {
+		LOG(LOG_ERROR, "update_rom_cache_directory: no directory for the ROM cache\n");
+		rom_cache_set_directory(NULL);
+		return;
+	}
+	
+	char *cache_directory = malloc(strlen(directory) + strlen("/neogeo_cache") + 1);
+	sprintf(cache_directory, "%s/neogeo_cache", directory);
+	rom_cache_set_directory(cache_directory);
+	free(cache_directory);
+}
+
+static void update_threaded_video(void) {
+	const char *value = core_option_value("neogeo_threaded_video");
+	video_set_threaded_rendering(value != NULL && strcmp(value, "enabled") == 0);
+}
+
+static bool update_sample_rate(void) {
+	const char *value = core_option_value("neogeo_sample_rate");
+	uint32_t rate = value != NULL ? (uint32_t)strtoul(value, NULL, 10) : 0;
+	if (rate == 0) {
+		rate = 44100;
+	}
+	if (rate == sound_get_sample_rate()) {
+		return false;
+	}
+	sound_set_sample_rate(rate);
+	return true;
+}
+
+static void update_audio_quality(void) {
+	const char *value = core_option_value("neogeo_audio_quality");
+	sound_quality_t quality = SOUND_QUALITY_FULL;
+	if (value != NULL && strcmp(value, "half rate") == 0) {
+		quality = SOUND_QUALITY_HALF_RATE;
+	}
+	else if (value != NULL && strcmp(value, "skip silent") == 0) {
+		quality = SOUND_QUALITY_SKIP_SILENT;
+	}
+	sound_set_quality(quality);
+}
 
 #pragma mark - libretro Interface
 
 void retro_set_environment(retro_environment_t cb) {
 	libretroCallbacks.environment = cb;
+	cb(RETRO_ENVIRONMENT_SET_VARIABLES, (void *)core_variables);
 }
 
 void retro_set_video_refresh(retro_video_refresh_t cb) {
@@ -42,6 +115,14 @@ void retro_init(void) {
 	retro_core_init_log();
 	LOG(LOG_DEBUG, "retro_init call\n");
 	
+	struct retro_perf_callback perf = { 0 };
+	uint64_t cpu_features = 0;
+	if (libretroCallbacks.environment(RETRO_ENVIRONMENT_GET_PERF_INTERFACE, &perf) && perf.get_cpu_features) {
+		cpu_features = perf.get_cpu_features();
+	}
+	libretroCallbacks.perf = perf;
+	video_kernels_init(cpu_features);
+	
 	char* systemDirectory;
 	libretroCallbacks.environment(RETRO_ENVIRONMENT_GET_SYSTEM_DIRECTORY, &systemDirectory);
 	retro_core_create_neogeo(systemDirectory);
@@ -58,7 +139,7 @@ void retro_init(void) {
 }
 
 void retro_deinit(void) {
-
+	video_set_threaded_rendering(false);
 }
 
 unsigned retro_api_version(void) {
@@ -74,13 +155,13 @@ void retro_get_system_info(struct retro_system_info *info) {
 }
 
 void retro_get_system_av_info(struct retro_system_av_info *info) {
-	info->timing.fps = 60;
-	info->timing.sample_rate = 44100;
+	info->timing.fps = FRAME_RATE;
+	info->timing.sample_rate = sound_get_sample_rate();
 	info->geometry.base_width = 320;
 	info->geometry.base_height = 224;
 	info->geometry.max_width = 320;
 	info->geometry.max_height = 224;
-	info->geometry.aspect_ratio = 320/224;
+	info->geometry.aspect_ratio = 320.0f/224.0f;
 }
 
 void retro_set_controller_port_device(unsigned port, unsigned device) {
@@ -96,6 +177,16 @@ void retro_reset(void) {
 void retro_run(void) {
 	static uint64_t frame_count = 0;
 	LOG(LOG_DEBUG, "--------------------------- run %u ---------------------------\n", frame_count);
+	bool variables_updated = false;
+	if (libretroCallbacks.environment(RETRO_ENVIRONMENT_GET_VARIABLE_UPDATE, &variables_updated) && variables_updated) {
+		update_threaded_video();
+		update_audio_quality();
+		if (update_sample_rate()) {
+			struct retro_system_av_info av_info;
+			retro_get_system_av_info(&av_info);
+			libretroCallbacks.environment(RETRO_ENVIRONMENT_SET_SYSTEM_AV_INFO, &av_info);
+		}
+	}
 	libretroCallbacks.inputPoll();
 	retro_core_poll_joypad_1();
 	retro_core_poll_joypad_2();
@@ -103,6 +194,7 @@ void retro_run(void) {
 	neogeo_runOneFrame();
 //	retro_core_draw_mire(video.frameBuffer, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT);
 	libretroCallbacks.audioBatch(audioBuffer, samplesThisFrame);
+	video_wait_lines();
 	libretroCallbacks.video(video.frameBuffer, FRAMEBUFFER_WIDTH, FRAMEBUFFER_HEIGHT, FRAMEBUFFER_WIDTH * sizeof(uint16_t));
 	frame_count++;
 }
@@ -140,6 +232,10 @@ bool retro_load_game(const struct retro_game_info *game) {
 		return true;
 	}
 	LOG(LOG_INFO, "loading game from %s\n", game->path);
+	update_rom_cache_directory();
+	update_threaded_video();
+	update_sample_rate();
+	update_audio_quality();
 	bool cartridge_valid = cartridge_load_roms(game->path);
 	if (cartridge_valid == false) {
 		LOG(LOG_ERROR, "invalid game from %s\n", game->path);
@@ -154,7 +250,9 @@ bool retro_load_game_special(unsigned game_type, const struct retro_game_info *i
 }
 
 void retro_unload_game(void) {
-
+	// The render thread reads the cartridge C ROMs
+	video_set_threaded_rendering(false);
+	cartridge_unload();
 }
 
 unsigned retro_get_region(void) {
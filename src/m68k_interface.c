@@ -1,3 +1,4 @@
+#include "endian.h"
 #include "memory_region.h"
 #include "neogeo.h"
 #include "rom_region.h"
@@ -5,6 +6,13 @@
 #include "3rdParty/musashi/m68kcpu.h"
 
 #include <stdint.h>
+#include <string.h>
+
+// Opcodes fetch page cache
+static uint32_t fetch_page_index = MEMORY_PAGES_COUNT;
+static uint8_t *fetch_page_data = NULL;
+
+static bool fetch_page_lookup(uint32_t address);
 
 void m68ki_exception_bus_error(void) {
      LOG(LOG_ERROR, "Bus Error @ PC=%X.\n", REG_PPC);
@@ -35,7 +43,13 @@ void m68ki_exception_bus_error(void) {
 }
 
 uint32_t m68k_read_memory_8(uint32_t address) {
-	const memory_region_t *memory_region = cpu_68k_memory_region_for_address(address);
+	const memory_page_t *page = &cpu_68k_read_pages[MEMORY_PAGE_INDEX(address)];
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (page->data) {
+		return page->data[NATIVE_WORD_BYTE_OFFSET(offset)];
+	}
+	
+	const memory_region_t *memory_region = page->region;
 	if (!memory_region) {
 		LOG(LOG_DEBUG, "m68k_read_memory_8 missing region for address 0x%08X\n", address);
 		m68ki_exception_bus_error();
@@ -48,11 +62,18 @@ uint32_t m68k_read_memory_8(uint32_t address) {
 		return 0xFF;
 	}
 	
-	return memory_region->handlers.read_byte(address - memory_region->start_address);
+	return memory_region->handlers.read_byte(page->offset + offset);
 }
 
 void m68k_write_memory_8(uint32_t address, uint32_t data) {
-	const memory_region_t *memory_region = cpu_68k_memory_region_for_address(address);
+	const memory_page_t *page = &cpu_68k_write_pages[MEMORY_PAGE_INDEX(address)];
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (page->data) {
+		page->data[NATIVE_WORD_BYTE_OFFSET(offset)] = (uint8_t)data;
+		return;
+	}
+	
+	const memory_region_t *memory_region = page->region;
 	if (!memory_region) {
 		LOG(LOG_DEBUG, "m68k_write_memory_8 missing region for address 0x%08X\n", address);
 		m68ki_exception_bus_error();
@@ -64,11 +85,21 @@ void m68k_write_memory_8(uint32_t address, uint32_t data) {
 		m68ki_exception_bus_error();
 		return;
 	}
-	memory_region->handlers.write_byte(address - memory_region->start_address, (uint8_t)data);
+	memory_region->handlers.write_byte(page->offset + offset, (uint8_t)data);
 }
 
 uint32_t m68k_read_memory_16(uint32_t address) {
-	const memory_region_t *memory_region = cpu_68k_memory_region_for_address(address);
+	const memory_page_t *page = &cpu_68k_read_pages[MEMORY_PAGE_INDEX(address)];
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (page->data) {
+		if (offset > MEMORY_PAGE_SIZE - 2) {
+			// crossing pages
+			return (m68k_read_memory_8(address) << 8) | m68k_read_memory_8(address + 1);
+		}
+		return *((uint16_t *)(page->data + offset));
+	}
+	
+	const memory_region_t *memory_region = page->region;
 	if (!memory_region) {
 		LOG(LOG_DEBUG, "m68k_read_memory_16 missing region for address 0x%08X\n", address);
 		m68ki_exception_bus_error();
@@ -81,11 +112,23 @@ uint32_t m68k_read_memory_16(uint32_t address) {
 		return 0xFFFF;
 	}
 	
-	return memory_region->handlers.read_word(address - memory_region->start_address);
+	return memory_region->handlers.read_word(page->offset + offset);
 }
 
 void m68k_write_memory_16(uint32_t address, uint32_t data) {
-	const memory_region_t *memory_region = cpu_68k_memory_region_for_address(address);
+	const memory_page_t *page = &cpu_68k_write_pages[MEMORY_PAGE_INDEX(address)];
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (page->data) {
+		if (offset > MEMORY_PAGE_SIZE - 2) {
+			m68k_write_memory_8(address, data >> 8);
+			m68k_write_memory_8(address + 1, data);
+			return;
+		}
+		*((uint16_t *)(page->data + offset)) = (uint16_t)data;
+		return;
+	}
+	
+	const memory_region_t *memory_region = page->region;
 	if (!memory_region) {
 		LOG(LOG_DEBUG, "m68k_write_memory_16 missing region for address 0x%08X\n", address);
 		m68ki_exception_bus_error();
@@ -97,11 +140,21 @@ void m68k_write_memory_16(uint32_t address, uint32_t data) {
 		m68ki_exception_bus_error();
 		return;
 	}
-	memory_region->handlers.write_word(address - memory_region->start_address, (uint16_t)data);
+	memory_region->handlers.write_word(page->offset + offset, (uint16_t)data);
 }
 
 uint32_t m68k_read_memory_32(uint32_t address) {
-	const memory_region_t *memory_region = cpu_68k_memory_region_for_address(address);
+	const memory_page_t *page = &cpu_68k_read_pages[MEMORY_PAGE_INDEX(address)];
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (page->data) {
+		if (offset > MEMORY_PAGE_SIZE - 4) {
+			// crossing pages
+			return (m68k_read_memory_16(address) << 16) | m68k_read_memory_16(address + 2);
+		}
+		return load_native_dword(page->data + offset);
+	}
+	
+	const memory_region_t *memory_region = page->region;
 	if (!memory_region) {
 		LOG(LOG_DEBUG, "m68k_read_memory_32 missing region for address 0x%08X\n", address);
 		m68ki_exception_bus_error();
@@ -114,11 +167,23 @@ uint32_t m68k_read_memory_32(uint32_t address) {
 		return 0xFFFF;
 	}
 	
-	return memory_region->handlers.read_dword(address - memory_region->start_address);
+	return memory_region->handlers.read_dword(page->offset + offset);
 }
 
 void m68k_write_memory_32(uint32_t address, uint32_t data) {
-	const memory_region_t *memory_region = cpu_68k_memory_region_for_address(address);
+	const memory_page_t *page = &cpu_68k_write_pages[MEMORY_PAGE_INDEX(address)];
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (page->data) {
+		if (offset > MEMORY_PAGE_SIZE - 4) {
+			m68k_write_memory_16(address, data >> 16);
+			m68k_write_memory_16(address + 2, data);
+			return;
+		}
+		store_native_dword(page->data + offset, data);
+		return;
+	}
+	
+	const memory_region_t *memory_region = page->region;
 	if (!memory_region) {
 		LOG(LOG_DEBUG, "m68k_write_memory_32 missing region for address 0x%08X\n", address);
 		m68ki_exception_bus_error();
@@ -130,5 +195,58 @@ void m68k_write_memory_32(uint32_t address, uint32_t data) {
 		m68ki_exception_bus_error();
 		return;
 	}
-	memory_region->handlers.write_dword(address - memory_region->start_address, data);
+	memory_region->handlers.write_dword(page->offset + offset, data);
+}
+
+#pragma mark - Opcodes fetch
+
+void cpu_68k_invalidate_fetch_page(void) {
+	fetch_page_index = MEMORY_PAGES_COUNT;
+	fetch_page_data = NULL;
+}
+
+static bool fetch_page_lookup(uint32_t address) {
+	uint32_t index = MEMORY_PAGE_INDEX(address);
+	if (index == fetch_page_index) {
+		return true;
+	}
+	uint8_t *data = cpu_68k_read_pages[index].data;
+	if (data == NULL) {
+		// I/O page, let handlers do the job
+		return false;
+	}
+	fetch_page_index = index;
+	fetch_page_data = data;
+	return true;
+}
+
+uint32_t m68k_read_immediate_16(uint32_t address) {
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (offset <= MEMORY_PAGE_SIZE - 2 && fetch_page_lookup(address)) {
+		return *((uint16_t *)(fetch_page_data + offset));
+	}
+	return m68k_read_memory_16(address);
+}
+
+uint32_t m68k_read_immediate_32(uint32_t address) {
+	uint32_t offset = address & MEMORY_PAGE_MASK;
+	if (offset <= MEMORY_PAGE_SIZE - 4 && fetch_page_lookup(address)) {
+		return load_native_dword(fetch_page_data + offset);
+	}
+	return m68k_read_memory_32(address);
+}
+
+uint32_t m68k_read_pcrelative_8(uint32_t address) {
+	if (fetch_page_lookup(address)) {
+		return fetch_page_data[NATIVE_WORD_BYTE_OFFSET(address & MEMORY_PAGE_MASK)];
+	}
+	return m68k_read_memory_8(address);
+}
+
+uint32_t m68k_read_pcrelative_16(uint32_t address) {
+	return m68k_read_immediate_16(address);
+}
+
+uint32_t m68k_read_pcrelative_32(uint32_t address) {
+	return m68k_read_immediate_32(address);
 }
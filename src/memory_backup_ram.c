@@ -1,3 +1,4 @@
+#include "endian.h"
 #include "memory_mapping.h"
 #include "memory_backup_ram.h"
 
@@ -8,7 +9,7 @@ memory_region_t backup_ram;			// BACKUP RAM - https://wiki.neogeodev.org/index.p
 memory_region_t backup_ram_mirror;
 
 static uint8_t backup_ram_read_byte(uint32_t offset) {
-	return backup_ram.data[offset];
+	return backup_ram.data[NATIVE_WORD_BYTE_OFFSET(offset)];
 }
 
 static uint16_t backup_ram_read_word(uint32_t offset) {
@@ -16,11 +17,11 @@ static uint16_t backup_ram_read_word(uint32_t offset) {
 }
 
 static uint32_t backup_ram_read_dword(uint32_t offset) {
-	return *((uint32_t *)(backup_ram.data + offset));
+	return load_native_dword(backup_ram.data + offset);
 }
 
 static void backup_ram_write_byte(uint32_t offset, uint8_t data) {
-	backup_ram.data[offset] = data;
+	backup_ram.data[NATIVE_WORD_BYTE_OFFSET(offset)] = data;
 }
 
 static void backup_ram_write_word(uint32_t offset, uint16_t data) {
@@ -28,7 +29,7 @@ static void backup_ram_write_word(uint32_t offset, uint16_t data) {
 }
 
 static void backup_ram_write_dword(uint32_t offset, uint32_t data) {
-	*((uint32_t *)(backup_ram.data + offset)) = data;
+	store_native_dword(backup_ram.data + offset, data);
 }
 
 void backup_ram_init(void) {
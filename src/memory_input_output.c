@@ -130,6 +130,7 @@ static uint8_t read_io_register(uint32_t address) {
 			result = 0;
 			break;
 		case REG_SOUND:
+			cpu_z80_sync();
 			result = z80_result;
 			LOG(LOG_DEBUG, "Z80 read command 0x%02X\n", result);
 			break;
@@ -182,6 +183,7 @@ static void write_io_register(uint32_t address, uint8_t data) {
 			break;
 		case REG_SOUND:
 			LOG(LOG_DEBUG, "Z80 command 0x%02X\n", data);
+			cpu_z80_sync();
 			z80_command = data;
 			cpu_z80_trigger_sound_command_nmi();
 			break;
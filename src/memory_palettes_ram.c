@@ -31,13 +31,13 @@ static void palettes_ram_write_byte(uint32_t offset, uint8_t data) {
 	current_palette_ram->data[offset] = data;
 	current_palette_ram->data[offset+1] = data;
 //	LOG(LOG_DEBUG, "palettes_ram_write_byte at offset 0x%08X - 0x%04X\n", offset, data);
-	video_convert_current_palette_color(offset/2);
+	video_palette_color_changed(offset/2);
 }
 
 static void palettes_ram_write_word(uint32_t offset, uint16_t data) {
 	*((uint16_t *)(current_palette_ram->data + offset)) = data;
 //	LOG(LOG_DEBUG, "palettes_ram_write_word at offset 0x%08X - 0x%04X\n", offset, data);
-	video_convert_current_palette_color(offset/2);
+	video_palette_color_changed(offset/2);
 }
 
 static void palettes_ram_write_dword(uint32_t offset, uint32_t data) {
@@ -45,8 +45,8 @@ static void palettes_ram_write_dword(uint32_t offset, uint32_t data) {
 	*(word_p) = (uint16_t)(data >> 16);
 	*(word_p + 1) = (uint16_t)data;
 //	LOG(LOG_DEBUG, "palettes_ram_write_dword at offset 0x%08X - 0x%08X\n", offset, data);
-	video_convert_current_palette_color(offset/2);
-	video_convert_current_palette_color(offset/2 + 1);
+	video_palette_color_changed(offset/2);
+	video_palette_color_changed(offset/2 + 1);
 }
 
 #pragma mark - Palettes mirror access
@@ -80,13 +80,13 @@ static void palettes_mirror_ram_write_byte(uint32_t offset, uint8_t data) {
 //	current_palette_ram->data[offset] = data;
 //	current_palette_ram->data[offset+1] = data;
 	LOG(LOG_DEBUG, "palettes_mirror_ram_write_byte at offset 0x%08X - 0x%04X\n", offset, data);
-//	video_convert_current_palette_color(offset/2);
+//	video_palette_color_changed(offset/2);
 }
 
 static void palettes_mirror_ram_write_word(uint32_t offset, uint16_t data) {
 //	*((uint16_t *)(current_palette_ram->data + offset)) = data;
 	LOG(LOG_DEBUG, "palettes_mirror_ram_write_word at offset 0x%08X - 0x%04X\n", offset, data);
-//	video_convert_current_palette_color(offset/2);
+//	video_palette_color_changed(offset/2);
 }
 
 static void palettes_mirror_ram_write_dword(uint32_t offset, uint32_t data) {
@@ -94,8 +94,8 @@ static void palettes_mirror_ram_write_dword(uint32_t offset, uint32_t data) {
 //	*(word_p) = (uint16_t)(data >> 16);
 //	*(word_p + 1) = (uint16_t)data;
 	LOG(LOG_DEBUG, "palettes_mirror_ram_write_dword at offset 0x%08X - 0x%08X\n", offset, data);
-//	video_convert_current_palette_color(offset/2);
-//	video_convert_current_palette_color(offset/2 + 1);
+//	video_palette_color_changed(offset/2);
+//	video_palette_color_changed(offset/2 + 1);
 }
 
 
@@ -22,4 +22,17 @@ typedef struct memory_region {
 	memory_region_access_handlers_t handlers;
 } memory_region_t;
 
+// 68K bus page tables: the 24 bits address space is split in 4KB pages
+#define MEMORY_PAGE_SHIFT	12
+#define MEMORY_PAGE_SIZE	(1 << MEMORY_PAGE_SHIFT)
+#define MEMORY_PAGE_MASK	(MEMORY_PAGE_SIZE - 1)
+#define MEMORY_PAGES_COUNT	(0x1000000 >> MEMORY_PAGE_SHIFT)
+#define MEMORY_PAGE_INDEX(address)	(((address) >> MEMORY_PAGE_SHIFT) & (MEMORY_PAGES_COUNT - 1))
+
+typedef struct memory_page {
+	uint8_t *data;					// native words RAM/ROM data of the page, accessed directly when not NULL
+	const memory_region_t *region;	// otherwise access through region handlers, NULL for a bus error
+	uint32_t offset;				// region offset of the first byte of the page
+} memory_page_t;
+
 #endif /* memory_region_h */
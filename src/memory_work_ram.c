@@ -9,27 +9,27 @@ memory_region_t work_ram;			// WORK RAM - https://wiki.neogeodev.org/index.php?t
 memory_region_t work_ram_mirror;
 
 static uint8_t work_ram_read_byte(uint32_t offset) {
-	return work_ram.data[offset];
+	return work_ram.data[NATIVE_WORD_BYTE_OFFSET(offset)];
 }
 
 static uint16_t work_ram_read_word(uint32_t offset) {
-	return BIG_ENDIAN_WORD(*((uint16_t *)(work_ram.data + offset)));
+	return *((uint16_t *)(work_ram.data + offset));
 }
 
 static uint32_t work_ram_read_dword(uint32_t offset) {
-	return BIG_ENDIAN_DWORD(*((uint32_t *)(work_ram.data + offset)));
+	return load_native_dword(work_ram.data + offset);
 }
 
 static void work_ram_write_byte(uint32_t offset, uint8_t data) {
-	work_ram.data[offset] = data;
+	work_ram.data[NATIVE_WORD_BYTE_OFFSET(offset)] = data;
 }
 
 static void work_ram_write_word(uint32_t offset, uint16_t data) {
-	*((uint16_t *)(work_ram.data + offset)) = BIG_ENDIAN_WORD(data);
+	*((uint16_t *)(work_ram.data + offset)) = data;
 }
 
 static void work_ram_write_dword(uint32_t offset, uint32_t data) {
-	*((uint32_t *)(work_ram.data + offset)) = BIG_ENDIAN_DWORD(data);
+	store_native_dword(work_ram.data + offset, data);
 }
 
 void work_ram_init(void) {
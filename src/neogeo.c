@@ -29,27 +29,32 @@ rom_region_t system_fix_rom;		// SFIX ROM - https://wiki.neogeodev.org/index.php
 
 #pragma mark - 68K CPU BUS / Memory regions
 
-memory_region_t p_rom_bank1_vector;
-memory_region_t system_rom_vector;
-
 memory_region_t input_output;
 
 memory_region_t memory_card;
 memory_region_t system_rom;			// SYSTEM ROM - https://wiki.neogeodev.org/index.php?title=System_ROM
-memory_region_t system_rom_mirror;
 
+memory_page_t cpu_68k_read_pages[MEMORY_PAGES_COUNT];
+memory_page_t cpu_68k_write_pages[MEMORY_PAGES_COUNT];
+
+static uint8_t board_vector_page[MEMORY_PAGE_SIZE];		// system ROM vectors + first P ROM page
+static uint8_t cartridge_vector_page[MEMORY_PAGE_SIZE];	// P ROM vectors + first system ROM page
 
 int32_t remainingCyclesThisFrame;
 int32_t m68kCyclesThisFrame;
 uint8_t pending_interrupts;
-int32_t z80_remaining_cycles;
-double currentTimeSeconds;
+int64_t currentTimeCycles;			// master cycles since reset, up to the running 68K slice
+static bool m68k_executing;
 
 #pragma mark -
 
 static void input_output_init(void);
 static void system_rom_init(rom_region_t rom);
 static void memory_card_init(void);
+static void cpu_68k_map_pages(void);
+static void cpu_68k_map_palette_pages(void);
+static void cpu_68k_map_direct_pages(memory_page_t *pages, uint32_t start_address, uint32_t end_address, uint8_t *data, uint32_t size);
+static void cpu_68k_map_region_pages(memory_page_t *pages, uint32_t start_address, uint32_t end_address, const memory_region_t *region, uint32_t size);
 
 #pragma mark - Components
 
@@ -74,7 +79,6 @@ void neogeo_initialize() {
 	palettes_rams_init();
 	memory_card_init();
 	memset(&system_rom, 0, sizeof(memory_region_t));
-	memset(&system_rom_mirror, 0, sizeof(memory_region_t));
 	backup_ram_init();
 	
 	// HARDWARE
@@ -89,25 +93,23 @@ void neogeo_deinitialize() {
 }
 
 void neogeo_reset() {
+	cpu_68k_map_pages();
 	neogeo_use_board_p_rom();
-	if (cartridge_plugged_in()) {
-		neogeo_use_cartridge_fix_rom();
-	}
-	else {
-		neogeo_use_board_fix_rom();
-	}
+	// Set directly and decoded once: the ROMs may have been reloaded at the same address
+	current_fix_rom = cartridge_plugged_in() ? cartridge_get_first_fix_rom() : &system_fix_rom;
+	video_update_fix_tiles();
 	
 	video_reset();
 	sound_reset();
 	
 	palettes_rams_reset();
 	current_palette_ram = &palettes_ram1;
+	cpu_68k_map_palette_pages();
 	
 	timers_group_reset();
 	remainingCyclesThisFrame = 0;
 	m68kCyclesThisFrame = 0;
-	z80_remaining_cycles = 0;
-	currentTimeSeconds = 0;
+	currentTimeCycles = 0;
 	
 	LOG(LOG_DEBUG, "neogeo_reset pulse\n");
 	m68k_pulse_reset();
@@ -125,26 +127,23 @@ void neogeo_runOneFrame() {
 		uint32_t cycles_slice = next_event_cycles < remainingCyclesThisFrame ? next_event_cycles : remainingCyclesThisFrame;
 		
 //		PROFILE(p_m68k, ProfilingCategory::CpuM68K);
+		m68k_executing = true;
 		uint32_t elapsed_cycles = m68kToMaster(m68k_execute(masterToM68k(cycles_slice)));
+		m68k_executing = false;
 //		PROFILE_END(p_m68k);
 
-		z80_remaining_cycles += elapsed_cycles;
-		if (z80_remaining_cycles > 0) {
-			uint32_t z80_elapsed;
-			//PROFILE(p_z80, ProfilingCategory::CpuZ80);
-			z80_elapsed = z80ToMaster(z80_execute(masterToZ80(z80_remaining_cycles)));
-			z80_remaining_cycles -= z80_elapsed;
-		}
-		
 		remainingCyclesThisFrame -= elapsed_cycles;
 		
-		currentTimeSeconds += masterToSeconds(elapsed_cycles);
+		currentTimeCycles += elapsed_cycles;
 
 //		PROFILE(p_videoIRQ, ProfilingCategory::VideoAndIRQ);
 		timer_group_consume_cycles(elapsed_cycles);
 //		PROFILE_END(p_videoIRQ);
 	}
-	LOG(LOG_DEBUG, "68k cycles remaining: %d - z80 cycles remaining %d\n", remainingCyclesThisFrame, z80_remaining_cycles);
+	
+	// The Z80 only ran when the 68K talked to it: catch up with the end of the frame
+	cpu_z80_sync();
+	LOG(LOG_DEBUG, "68k cycles remaining: %d\n", remainingCyclesThisFrame);
 	sound_finalize_one_frame();
 }
 
@@ -163,31 +162,41 @@ bool neogeo_is_system_ready() {
 
 void neogeo_use_palette_bank_1() {
 	LOG(LOG_DEBUG, "neogeo_use_palette_bank_1\n");
+	video_use_palette_bank(0);
 	current_palette_ram = &palettes_ram1;
-	video_convert_current_palette_bank();
+	cpu_68k_map_palette_pages();
 }
 
 void neogeo_use_palette_bank_2() {
 	LOG(LOG_DEBUG, "neogeo_use_palette_bank_2\n");
+	video_use_palette_bank(1);
 	current_palette_ram = &palettes_ram2;
-	video_convert_current_palette_bank();
+	cpu_68k_map_palette_pages();
 }
 
 #pragma mark Fix ROM
 
 void neogeo_use_board_fix_rom() {
 	LOG(LOG_DEBUG, "neogeo_use_board_fix_rom\n");
-	current_fix_rom = &system_fix_rom;
+	timer_group_sync_video();
+	if (current_fix_rom != &system_fix_rom) {
+		current_fix_rom = &system_fix_rom;
+		video_update_fix_tiles();
+	}
 	//TODO: M1 ROM too
 }
 
 void neogeo_use_cartridge_fix_rom() {
 	LOG(LOG_DEBUG, "neogeo_use_cartridge_fix_rom\n");
+	timer_group_sync_video();
 	if (cartridge_plugged_in() == false) {
 		LOG(LOG_ERROR, "neogeo_use_cartridge_fix_rom when cartridge is not plugged in\n");
 		return;
 	}
-	current_fix_rom = cartridge_get_first_fix_rom();
+	if (current_fix_rom != cartridge_get_first_fix_rom()) {
+		current_fix_rom = cartridge_get_first_fix_rom();
+		video_update_fix_tiles();
+	}
 	//M1
 }
 
@@ -195,11 +204,15 @@ void neogeo_use_cartridge_fix_rom() {
 
 void neogeo_use_board_p_rom() {
 	LOG(LOG_DEBUG, "neogeo_use_board_p_rom\n");
-	p_rom_bank1_vector = system_rom;
-	p_rom_bank1_vector.start_address = p_rom_bank1.start_address;
+	// vectors are swapped: build both first pages with the other ROM vector table
+	memcpy(board_vector_page, p_rom_bank1.data, MEMORY_PAGE_SIZE);
+	memcpy(board_vector_page, system_rom.data, ROM_VECTOR_TABLE_SIZE);
+	memcpy(cartridge_vector_page, system_rom.data, MEMORY_PAGE_SIZE);
+	memcpy(cartridge_vector_page, p_rom_bank1.data, ROM_VECTOR_TABLE_SIZE);
 	
-	system_rom_vector = p_rom_bank1;
-	system_rom_vector.start_address = system_rom.start_address;
+	cpu_68k_read_pages[MEMORY_PAGE_INDEX(ROM_BANK1_START)].data = board_vector_page;
+	cpu_68k_read_pages[MEMORY_PAGE_INDEX(SYSTEM_ROM_START)].data = cartridge_vector_page;
+	cpu_68k_invalidate_fetch_page();
 }
 
 void neogeo_use_cartridge_p_rom() {
@@ -208,8 +221,16 @@ void neogeo_use_cartridge_p_rom() {
 		LOG(LOG_ERROR, "neogeo_use_cartridge_p_rom when cartridge is not plugged in\n");
 		return;
 	}
-	p_rom_bank1_vector = p_rom_bank1;
-	system_rom_vector = system_rom;
+	cpu_68k_read_pages[MEMORY_PAGE_INDEX(ROM_BANK1_START)].data = p_rom_bank1.data;
+	cpu_68k_read_pages[MEMORY_PAGE_INDEX(SYSTEM_ROM_START)].data = system_rom.data;
+	cpu_68k_invalidate_fetch_page();
+}
+
+#pragma mark P ROM bank
+
+void neogeo_map_p_rom_bank2() {
+	cpu_68k_map_direct_pages(cpu_68k_read_pages, ROM_BANK2_START, ROM_BANK2_END, p_rom_bank2.data, ROM_BANK1_SIZE);
+	cpu_68k_invalidate_fetch_page();
 }
 
 #pragma mark System ROMs
@@ -222,6 +243,7 @@ bool neogeo_set_system_Y_zoom_ROM(rom_region_t rom) {
 bool neogeo_set_system_fix_ROM(rom_region_t rom) {
 	system_fix_rom = rom;
 	current_fix_rom = &system_fix_rom;
+	video_update_fix_tiles();
 	return true;
 }
 
@@ -233,60 +255,18 @@ bool neogeo_set_system_ROM(rom_region_t rom) {
 	}
 	LOG(LOG_DEBUG, "neogeo_set_system_ROM %p - %ld bytes\n", rom.data, rom.size);
 	byte_swap_p_rom_if_needed(rom.data, rom.size);
+	if (rom.size < SYSTEM_ROM_SIZE) {
+		// whole system ROM pages are mapped
+		rom.data = realloc(rom.data, SYSTEM_ROM_SIZE);
+		memset(rom.data + rom.size, 0, SYSTEM_ROM_SIZE - rom.size);
+		rom.size = SYSTEM_ROM_SIZE;
+	}
 	system_rom_init(rom);
 	return true;
 }
 
 #pragma mark 68K CPU bus access
 
-const memory_region_t* cpu_68k_memory_region_for_address(uint32_t address) {
-	if (address <= ROM_BANK1_END) {
-		if ((address - ROM_BANK1_START) < ROM_VECTOR_TABLE_SIZE) {
-			return &p_rom_bank1_vector;
-		}
-		return &p_rom_bank1;
-	}
-	else if (address <= WORK_RAM_END && address >= WORK_RAM_START) {
-		return &work_ram;
-	}
-	else if (address <= WORK_RAM_MIRROR_END && address >= WORK_RAM_MIRROR_START) {
-		return &work_ram_mirror;
-	}
-	else if (address <= ROM_BANK2_END && address >= ROM_BANK2_START) {
-		return &p_rom_bank2;
-	}
-	else if (address <= IO_PORTS_END && address >= IO_PORTS_START) {
-		return &input_output;
-	}
-	else if (address <= PALETTES_RAM_END && address >= PALETTES_RAM_START) {
-		return current_palette_ram;
-	}
-	else if (address <= PALETTES_RAM_MIRROR_END && address >= PALETTES_RAM_MIRROR_START) {
-		return &palettes_ram_mirror;
-	}
-	else if (address <= MEMCARD_END && address >= MEMCARD_START) {
-		return &memory_card;
-	}
-	else if (address <= SYSTEM_ROM_END && address >= SYSTEM_ROM_START) {
-		if ((address - SYSTEM_ROM_START) < ROM_VECTOR_TABLE_SIZE) {
-			return &system_rom_vector;
-		}
-		return &system_rom;
-	}
-	else if (address <= SYSTEM_ROM_MIRROR_END && address >= SYSTEM_ROM_MIRROR_START) {
-		return &system_rom_mirror;
-	}
-	else if (address <= BACKUP_RAM_END && address >= BACKUP_RAM_START) {
-		return &backup_ram;
-	}
-	else if (address <= BACKUP_RAM_MIRROR_END && address >= BACKUP_RAM_MIRROR_START) {
-		return &backup_ram;
-	}
-	
-	LOG(LOG_ERROR, "68K CPU bus access outside known address 0x%08X\n", address);
-	return NULL;
-}
-
 void cpu_68k_update_interrupts() {
 	unsigned int level = 0;
 	if (pending_interrupts & VBlank) {
@@ -315,36 +295,94 @@ void cpu_68k_ack_interrupt(cpu_68k_irq_m irq) {
 	pending_interrupts &= ~irq;
 }
 
-int32_t cpu_68k_get_remaining_master_cycles() {
-	return remainingCyclesThisFrame;
+int64_t cpu_68k_get_master_cycles() {
+	if (m68k_executing) {
+		return currentTimeCycles + m68kToMaster(m68k_cycles_run());
+	}
+	return currentTimeCycles;
 }
 
-#pragma mark - YM2610
-
-double ym2610_fm_get_time_now(void)
-{
-	return currentTimeSeconds;
+int64_t cpu_68k_get_frame_end_master_cycles() {
+	return currentTimeCycles + remainingCyclesThisFrame;
 }
 
 #pragma mark - Private
 
+#pragma mark 68K CPU page tables
+
+static void cpu_68k_map_direct_pages(memory_page_t *pages, uint32_t start_address, uint32_t end_address, uint8_t *data, uint32_t size) {
+	for (uint32_t address = start_address; address <= end_address; address += MEMORY_PAGE_SIZE) {
+		memory_page_t *page = &pages[MEMORY_PAGE_INDEX(address)];
+		page->offset = (address - start_address) % size;
+		page->data = data + page->offset;
+		page->region = NULL;
+	}
+}
+
+static void cpu_68k_map_region_pages(memory_page_t *pages, uint32_t start_address, uint32_t end_address, const memory_region_t *region, uint32_t size) {
+	for (uint32_t address = start_address; address <= end_address; address += MEMORY_PAGE_SIZE) {
+		memory_page_t *page = &pages[MEMORY_PAGE_INDEX(address)];
+		page->offset = (address - start_address) % size;
+		page->data = NULL;
+		page->region = region;
+	}
+}
+
+static void cpu_68k_map_palette_pages(void) {
+	cpu_68k_map_region_pages(cpu_68k_read_pages, PALETTES_RAM_START, PALETTES_RAM_END, current_palette_ram, PALETTES_RAM_SIZE);
+	cpu_68k_map_region_pages(cpu_68k_write_pages, PALETTES_RAM_START, PALETTES_RAM_END, current_palette_ram, PALETTES_RAM_SIZE);
+}
+
+static void cpu_68k_map_pages(void) {
+	// unmapped pages raise a bus error
+	memset(cpu_68k_read_pages, 0, sizeof(cpu_68k_read_pages));
+	memset(cpu_68k_write_pages, 0, sizeof(cpu_68k_write_pages));
+	
+	// ROM writes still go to handlers: bus error or bank switch
+	cpu_68k_map_direct_pages(cpu_68k_read_pages, ROM_BANK1_START, ROM_BANK1_END, p_rom_bank1.data, ROM_BANK1_SIZE);
+	cpu_68k_map_region_pages(cpu_68k_write_pages, ROM_BANK1_START, ROM_BANK1_END, &p_rom_bank1, ROM_BANK1_SIZE);
+	
+	cpu_68k_map_direct_pages(cpu_68k_read_pages, WORK_RAM_START, WORK_RAM_MIRROR_END, work_ram.data, WORK_RAM_SIZE);
+	cpu_68k_map_direct_pages(cpu_68k_write_pages, WORK_RAM_START, WORK_RAM_MIRROR_END, work_ram.data, WORK_RAM_SIZE);
+	
+	neogeo_map_p_rom_bank2();
+	cpu_68k_map_region_pages(cpu_68k_write_pages, ROM_BANK2_START, ROM_BANK2_END, &p_rom_bank2, ROM_BANK1_SIZE);
+	
+	cpu_68k_map_region_pages(cpu_68k_read_pages, IO_PORTS_START, IO_PORTS_END, &input_output, IO_PORTS_END - IO_PORTS_START + 1);
+	cpu_68k_map_region_pages(cpu_68k_write_pages, IO_PORTS_START, IO_PORTS_END, &input_output, IO_PORTS_END - IO_PORTS_START + 1);
+	
+	cpu_68k_map_palette_pages();
+	cpu_68k_map_region_pages(cpu_68k_read_pages, PALETTES_RAM_MIRROR_START, PALETTES_RAM_MIRROR_END, &palettes_ram_mirror, PALETTES_RAM_SIZE);
+	cpu_68k_map_region_pages(cpu_68k_write_pages, PALETTES_RAM_MIRROR_START, PALETTES_RAM_MIRROR_END, &palettes_ram_mirror, PALETTES_RAM_SIZE);
+	
+	cpu_68k_map_direct_pages(cpu_68k_read_pages, MEMCARD_START, MEMCARD_END, memory_card.data, MEMCARD_SIZE);
+	cpu_68k_map_direct_pages(cpu_68k_write_pages, MEMCARD_START, MEMCARD_END, memory_card.data, MEMCARD_SIZE);
+	
+	cpu_68k_map_direct_pages(cpu_68k_read_pages, SYSTEM_ROM_START, SYSTEM_ROM_MIRROR_END, system_rom.data, SYSTEM_ROM_SIZE);
+	cpu_68k_map_region_pages(cpu_68k_write_pages, SYSTEM_ROM_START, SYSTEM_ROM_MIRROR_END, &system_rom, SYSTEM_ROM_SIZE);
+	
+	cpu_68k_map_direct_pages(cpu_68k_read_pages, BACKUP_RAM_START, BACKUP_RAM_MIRROR_END, backup_ram.data, BACKUP_RAM_SIZE);
+	cpu_68k_map_direct_pages(cpu_68k_write_pages, BACKUP_RAM_START, BACKUP_RAM_MIRROR_END, backup_ram.data, BACKUP_RAM_SIZE);
+	
+	cpu_68k_invalidate_fetch_page();
+}
+
 #pragma mark system P ROM access
 
 static uint8_t system_rom_read_byte(uint32_t offset) {
-	return system_rom.data[offset];
+	return system_rom.data[NATIVE_WORD_BYTE_OFFSET(offset)];
 }
 
 static uint16_t system_rom_read_word(uint32_t offset) {
-	return BIG_ENDIAN_WORD(*((uint16_t *)(system_rom.data + offset)));
+	return *((uint16_t *)(system_rom.data + offset));
 }
 
 static uint32_t system_rom_read_dword(uint32_t offset) {
-	return BIG_ENDIAN_DWORD(*((uint32_t *)(system_rom.data + offset)));
+	return load_native_dword(system_rom.data + offset);
 }
 
 static void system_rom_init(rom_region_t rom) {
 	memset(&system_rom, 0, sizeof(memory_region_t));
-	memset(&system_rom_mirror, 0, sizeof(memory_region_t));
 	
 	system_rom.data = rom.data;
 	system_rom.size = rom.size;
@@ -353,12 +391,6 @@ static void system_rom_init(rom_region_t rom) {
 	system_rom.handlers.read_byte = &system_rom_read_byte;
 	system_rom.handlers.read_word = &system_rom_read_word;
 	system_rom.handlers.read_dword = &system_rom_read_dword;
-	
-	system_rom_mirror.data = system_rom.data;
-	system_rom_mirror.size = system_rom.size;
-	system_rom_mirror.start_address = SYSTEM_ROM_MIRROR_START;
-	system_rom_mirror.end_address = SYSTEM_ROM_MIRROR_END;
-	system_rom_mirror.handlers = system_rom.handlers;
 		
 	uint8_t nationality = system_rom.handlers.read_byte(0x401);
 	char *nat_str;
@@ -409,7 +441,7 @@ static void input_output_init(void) {
 #pragma mark memory card
 
 static uint8_t memory_card_read_byte(uint32_t offset) {
-	return memory_card.data[offset];
+	return memory_card.data[NATIVE_WORD_BYTE_OFFSET(offset)];
 }
 
 static uint16_t memory_card_read_word(uint32_t offset) {
@@ -417,11 +449,11 @@ static uint16_t memory_card_read_word(uint32_t offset) {
 }
 
 static uint32_t memory_card_read_dword(uint32_t offset) {
-	return *((uint32_t *)(memory_card.data + offset));
+	return load_native_dword(memory_card.data + offset);
 }
 
 static void memory_card_write_byte(uint32_t offset, uint8_t data) {
-	memory_card.data[offset] = data;
+	memory_card.data[NATIVE_WORD_BYTE_OFFSET(offset)] = data;
 }
 
 static void memory_card_write_word(uint32_t offset, uint16_t data) {
@@ -429,7 +461,7 @@ static void memory_card_write_word(uint32_t offset, uint16_t data) {
 }
 
 static void memory_card_write_dword(uint32_t offset, uint32_t data) {
-	*((uint32_t *)(memory_card.data + offset)) = data;
+	store_native_dword(memory_card.data + offset, data);
 }
 
 static void memory_card_init(void) {
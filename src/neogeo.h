@@ -28,6 +28,7 @@ void neogeo_use_cartridge_fix_rom(void);
 
 void neogeo_use_board_p_rom(void);
 void neogeo_use_cartridge_p_rom(void);
+void neogeo_map_p_rom_bank2(void);
 
 #pragma mark - Lifecycle
 
@@ -47,9 +48,13 @@ bool neogeo_is_system_ready(void);
 
 #pragma mark - 68K CPU bus access
 
-const memory_region_t* cpu_68k_memory_region_for_address(uint32_t address);
+extern memory_page_t cpu_68k_read_pages[MEMORY_PAGES_COUNT];
+extern memory_page_t cpu_68k_write_pages[MEMORY_PAGES_COUNT];
+void cpu_68k_invalidate_fetch_page(void);
+
 void cpu_68k_set_interrupt(cpu_68k_irq_m irq);
 void cpu_68k_ack_interrupt(cpu_68k_irq_m irq);
-int32_t cpu_68k_get_remaining_master_cycles(void);
+int64_t cpu_68k_get_master_cycles(void);
+int64_t cpu_68k_get_frame_end_master_cycles(void);
 
 #endif /* neogeo_h */
@@ -0,0 +1,223 @@
+#define _POSIX_C_SOURCE 200809L	// mmap, fileno, mkdir
+
+#include "rom_cache.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Cache file layout: a header followed by the sections, each one starting on its own page.
+// Data is stored as used in memory (native words P ROMs...) so the file is bound to
+// the host byte order and to this version of the post-processing.
+
+#define ROM_CACHE_VERSION	1
+#define ROM_CACHE_ALIGNMENT	4096
+#define ROM_CACHE_BYTE_ORDER	0x01020304
+
+static const char ROM_CACHE_MAGIC[8] = "NGROMCH";
+
+typedef struct rom_cache_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;		// ROM_CACHE_BYTE_ORDER as written by the host
+	uint32_t key;				// game zip contents key
+	uint32_t sections_count;
+	struct {
+		uint64_t offset;
+		uint64_t size;
+	} sections[ROM_CACHE_SECTIONS_COUNT];
+} rom_cache_header_t;
+
+static char *cache_directory = NULL;
+
+static char *rom_cache_file_path(const char *game_path);
+
+#pragma mark - Public
+
+void rom_cache_set_directory(const char *directory) {
+	free(cache_directory);
+	cache_directory = NULL;
+	if (directory == NULL) {
+		return;
+	}
+
+	cache_directory = malloc(strlen(directory) + 1);
+	strcpy(cache_directory, directory);
+#ifndef _WIN32
+	mkdir(cache_directory, 0755);
+#endif
+	LOG(LOG_INFO, "rom_cache_set_directory: caching games in %s\n", cache_directory);
+}
+
+bool rom_cache_enabled(void) {
+	return cache_directory != NULL;
+}
+
+#ifndef _WIN32
+
+bool rom_cache_load(rom_cache_t *cache, const char *game_path, uint32_t key) {
+	memset(cache, 0, sizeof(rom_cache_t));
+	char *path = rom_cache_file_path(game_path);
+	if (path == NULL) {
+		return false;
+	}
+
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		LOG(LOG_DEBUG, "rom_cache_load: no cache file at %s\n", path);
+		free(path);
+		return false;
+	}
+
+	struct stat file_stat;
+	void *mapping = MAP_FAILED;
+	if (fstat(fd, &file_stat) == 0 && (size_t)file_stat.st_size >= sizeof(rom_cache_header_t)) {
+		mapping = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		LOG(LOG_ERROR, "rom_cache_load: can't map %s\n", path);
+		free(path);
+		return false;
+	}
+
+	size_t mapping_size = file_stat.st_size;
+	const rom_cache_header_t *header = mapping;
+	bool valid = memcmp(header->magic, ROM_CACHE_MAGIC, sizeof(ROM_CACHE_MAGIC)) == 0
+				&& header->version == ROM_CACHE_VERSION
+				&& header->byte_order == ROM_CACHE_BYTE_ORDER
+				&& header->key == key
+				&& header->sections_count == ROM_CACHE_SECTIONS_COUNT;
+	for (int i = 0; valid && i < ROM_CACHE_SECTIONS_COUNT; i++) {
+		uint64_t offset = header->sections[i].offset;
+		uint64_t size = header->sections[i].size;
+		valid = offset <= mapping_size && size <= mapping_size - offset;
+		cache->sections[i].data = size > 0 ? (uint8_t *)mapping + offset : NULL;
+		cache->sections[i].size = size;
+	}
+	if (!valid) {
+		LOG(LOG_INFO, "rom_cache_load: %s is outdated\n", path);
+		munmap(mapping, mapping_size);
+		memset(cache, 0, sizeof(rom_cache_t));
+		free(path);
+		return false;
+	}
+
+	cache->mapping = mapping;
+	cache->mapping_size = mapping_size;
+	LOG(LOG_INFO, "rom_cache_load: mapped %s\n", path);
+	free(path);
+	return true;
+}
+
+bool rom_cache_save(const rom_cache_t *cache, const char *game_path, uint32_t key) {
+	char *path = rom_cache_file_path(game_path);
+	if (path == NULL) {
+		return false;
+	}
+
+	rom_cache_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, ROM_CACHE_MAGIC, sizeof(ROM_CACHE_MAGIC));
+	header.version = ROM_CACHE_VERSION;
+	header.byte_order = ROM_CACHE_BYTE_ORDER;
+	header.key = key;
+	header.sections_count = ROM_CACHE_SECTIONS_COUNT;
+	uint64_t offset = ROM_CACHE_ALIGNMENT;
+	for (int i = 0; i < ROM_CACHE_SECTIONS_COUNT; i++) {
+		size_t size = cache->sections[i].data != NULL ? cache->sections[i].size : 0;
+		header.sections[i].offset = offset;
+		header.sections[i].size = size;
+		offset += (size + ROM_CACHE_ALIGNMENT - 1) & ~(uint64_t)(ROM_CACHE_ALIGNMENT - 1);
+	}
+
+	// Written aside then renamed, so other instances never map a partial file
+	char *temporary_path = malloc(strlen(path) + 16);
+	sprintf(temporary_path, "%s.%ld", path, (long)getpid());
+	FILE *file = fopen(temporary_path, "wb");
+	bool written = file != NULL && fwrite(&header, sizeof(header), 1, file) == 1;
+	for (int i = 0; written && i < ROM_CACHE_SECTIONS_COUNT; i++) {
+		written = fseek(file, (long)header.sections[i].offset, SEEK_SET) == 0
+				&& fwrite(cache->sections[i].data, 1, header.sections[i].size, file) == header.sections[i].size;
+	}
+	// Pads the last section so the file covers all the pages
+	written = written && ftruncate(fileno(file), (off_t)offset) == 0;
+	if (file != NULL && fclose(file) != 0) {
+		written = false;
+	}
+	if (written) {
+		written = rename(temporary_path, path) == 0;
+	}
+	if (!written) {
+		LOG(LOG_ERROR, "rom_cache_save: can't write %s\n", path);
+		remove(temporary_path);
+	}
+	else {
+		LOG(LOG_INFO, "rom_cache_save: saved %lld MB to %s\n", (long long)(offset / (1024*1024)), path);
+	}
+
+	free(temporary_path);
+	free(path);
+	return written;
+}
+
+void rom_cache_release(rom_cache_t *cache) {
+	if (cache->mapping != NULL) {
+		munmap(cache->mapping, cache->mapping_size);
+	}
+	memset(cache, 0, sizeof(rom_cache_t));
+}
+
+#else
+
+// No mmap: the cache is never used
+
+bool rom_cache_load(rom_cache_t *cache, const char *game_path, uint32_t key) {
+	memset(cache, 0, sizeof(rom_cache_t));
+	return false;
+}
+
+bool rom_cache_save(const rom_cache_t *cache, const char *game_path, uint32_t key) {
+	return false;
+}
+
+void rom_cache_release(rom_cache_t *cache) {
+	memset(cache, 0, sizeof(rom_cache_t));
+}
+
+#endif
+
+#pragma mark - Private
+
+/*
+ *	One cache file per game, named after the game zip: a changed zip replaces it
+ */
+static char *rom_cache_file_path(const char *game_path) {
+	if (cache_directory == NULL || game_path == NULL) {
+		return NULL;
+	}
+
+	const char *name = strrchr(game_path, '/');
+	const char *windows_name = strrchr(game_path, '\\');
+	if (windows_name != NULL && (name == NULL || windows_name > name)) {
+		name = windows_name;
+	}
+	name = name != NULL ? name + 1 : game_path;
+	size_t name_length = strlen(name);
+	const char *extension = strrchr(name, '.');
+	if (extension != NULL) {
+		name_length = extension - name;
+	}
+
+	char *path = malloc(strlen(cache_directory) + name_length + sizeof("/.cache"));
+	sprintf(path, "%s/%.*s.cache", cache_directory, (int)name_length, name);
+	return path;
+}
@@ -0,0 +1,36 @@
+#ifndef rom_cache_h
+#define rom_cache_h
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rom_region.h"
+
+// Post-processed cartridge images, saved after a first load and mapped back on the next ones
+typedef enum rom_cache_section {
+	ROM_CACHE_P_ROM_BANK1,
+	ROM_CACHE_P_ROM_BANKS,
+	ROM_CACHE_SERIALIZED_C_ROMS,
+	ROM_CACHE_CHARACTERS_LINES_USAGE,
+	ROM_CACHE_S_ROM,
+	ROM_CACHE_M1_ROM,
+	ROM_CACHE_PCM_A,
+	ROM_CACHE_PCM_B,
+	ROM_CACHE_SECTIONS_COUNT
+} rom_cache_section_t;
+
+typedef struct rom_cache {
+	rom_region_t sections[ROM_CACHE_SECTIONS_COUNT];
+	void *mapping;			// read only file mapping the sections point into, NULL when not loaded
+	size_t mapping_size;
+} rom_cache_t;
+
+void rom_cache_set_directory(const char *directory);	// NULL disables the cache
+bool rom_cache_enabled(void);
+
+bool rom_cache_load(rom_cache_t *cache, const char *game_path, uint32_t key);
+bool rom_cache_save(const rom_cache_t *cache, const char *game_path, uint32_t key);
+void rom_cache_release(rom_cache_t *cache);
+
+#endif /* rom_cache_h */
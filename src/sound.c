@@ -1,4 +1,6 @@
+#include "audio_resampler.h"
 #include "cartridge.h"
+#include "libretro_core.h"
 #include "log.h"
 #include "memory_mapping.h"
 #include "neogeo.h"
@@ -15,26 +17,58 @@
 
 void YM2610IrqHandler(int irq);
 void YM2610TimerHandler(int channel, int count, double steptime);
+static void sound_generate_samples(uint32_t count);
 
 
-/// Buffer for the generated audio
-FMSAMPLE *audioBuffer;
-size_t audio_buffer_size;
+/// The YM2610 runs at its native FM rate, resampled to the output rate at the end of each frame
+static const double YM2610_NATIVE_RATE = YM2610_CLOCK / 144;	// 55.5 kHz
+static double ym2610_sample_rate = YM2610_NATIVE_RATE;
+static uint32_t audio_sample_rate = 44100;
+
+/// Quality tier, the YM2610 rate changes on the next reset
+static sound_quality_t audio_quality = SOUND_QUALITY_FULL;
+static const char *audio_quality_names[] = { "full", "half rate", "skip silent" };
 
-/// How many samples to generate this frame (this can vary because of rounding)
-double samplesThisFrameF;
+/// Time spent generating and resampling, reported every AUDIO_COST_FRAMES
+#define AUDIO_COST_FRAMES	600
+static retro_time_t audio_cost_usec;
+static uint32_t audio_cost_frames;
+
+/// Buffer for the output audio
+FMSAMPLE *audioBuffer;
+static uint32_t audio_buffer_frames;
 
-/// How many samples to generate this frame (this can vary because of rounding)
+/// How many output samples were made this frame
 uint32_t samplesThisFrame;
 
-/// The index of the sample corresponding to the current emulated time
+/// Buffer for the YM2610 samples of the frame
+static FMSAMPLE *ym2610_buffer;
+static uint32_t ym2610_buffer_frames;
+
+/// How many YM2610 samples to generate this frame (this can vary because of rounding)
+double ym2610SamplesThisFrameF;
+uint32_t ym2610SamplesThisFrame;
+
+/// The index of the YM2610 sample corresponding to the current emulated time
 uint32_t currentSample;
 
-/// Write index for audio data
+/// Write index for YM2610 samples
 uint32_t audioWritePointer;
 
 bool z80NMIDisabled = true;
 
+#pragma mark - Z80 timeline
+
+/// The Z80 and the YM2610 run behind the 68K and catch up on demand
+static int64_t z80_time;				// master cycles reached by the Z80
+static bool z80_executing;
+static int32_t z80_slice_cycles;		// length of the running z80_execute() call
+
+/// YM2610 timers expire on the Z80 timeline
+static bool ym2610_timer_active[2];
+static int64_t ym2610_timer_deadline[2];
+static int64_t ym2610_timer_reload_time = -1;	// expired deadline while reloading, to avoid drift
+
 #pragma mark - Z80 memory map
 
 uint32_t z80_bank_0_offset;
@@ -60,8 +94,9 @@ void sound_init() {
 	z80_work_ram.data = malloc(Z80_RAM_SIZE);
 	z80_work_ram.size = Z80_RAM_SIZE;
 	
-	audio_buffer_size = sizeof(FMSAMPLE) * 2 * ((AUDIO_SAMPLE_RATE / FRAME_RATE) + 1);
-	audioBuffer = malloc(audio_buffer_size);
+	ym2610_buffer_frames = (uint32_t)(YM2610_NATIVE_RATE / FRAME_RATE) + 2;
+	ym2610_buffer = malloc(sizeof(FMSAMPLE) * 2 * ym2610_buffer_frames);
+	sound_set_sample_rate(audio_sample_rate);
 	
 	z80_init(0, Z80_CLOCK, NULL, z80_irq_callback);
 }
@@ -74,54 +109,94 @@ void sound_reset() {
 	
 	memset(z80_work_ram.data, 0, Z80_RAM_SIZE);
 	
-	samplesThisFrameF = 0;
+	ym2610SamplesThisFrameF = 0;
+	ym2610SamplesThisFrame = 0;
 	samplesThisFrame = 0;
 	currentSample = 0;
 	audioWritePointer = 0;
-	memset(audioBuffer, 0, audio_buffer_size);
+	audio_cost_usec = 0;
+	audio_cost_frames = 0;
 	
 	z80NMIDisabled = true;
 	
 	z80_reset();
+	z80_time = 0;
+	z80_executing = false;
+	ym2610_timer_active[0] = false;
+	ym2610_timer_active[1] = false;
 	
-	if (pcm_rom_a.data != NULL) {
-		free(pcm_rom_a.data);
-		pcm_rom_a.size = 0;
-	}
-	if (pcm_rom_b.data != NULL) {
-		free(pcm_rom_b.data);
-		pcm_rom_b.size = 0;
-	}
-	pcm_rom_a = cartridge_create_pcm_rom(0);
+	pcm_rom_a = cartridge_get_pcm_rom(0);
 	LOG(LOG_INFO, "sound_reset: found %d KB of PCM A\n", pcm_rom_a.size / 1024);
-	pcm_rom_b = cartridge_create_pcm_rom(1);
+	pcm_rom_b = cartridge_get_pcm_rom(1);
 	LOG(LOG_INFO, "sound_reset: found %d KB of PCM B\n", pcm_rom_b.size / 1024);
 	
-	ym2610_init(YM2610_CLOCK, AUDIO_SAMPLE_RATE, pcm_rom_a.data, pcm_rom_a.size, pcm_rom_b.data, pcm_rom_b.size, &YM2610TimerHandler, &YM2610IrqHandler);
+	ym2610_sample_rate = audio_quality == SOUND_QUALITY_HALF_RATE ? YM2610_NATIVE_RATE / 2 : YM2610_NATIVE_RATE;
+	audio_resampler_set_rates(ym2610_sample_rate, audio_sample_rate);
+	audio_resampler_reset();
+	ym2610_init(YM2610_CLOCK, ym2610_sample_rate, pcm_rom_a.data, pcm_rom_a.size, pcm_rom_b.data, pcm_rom_b.size, &YM2610TimerHandler, &YM2610IrqHandler);
+}
+
+void sound_set_sample_rate(uint32_t rate) {
+	audio_sample_rate = rate;
+	// The resampler carries the fraction of sample from frame to frame
+	audio_buffer_frames = (uint32_t)(rate / FRAME_RATE) + 2;
+	audioBuffer = realloc(audioBuffer, sizeof(FMSAMPLE) * 2 * audio_buffer_frames);
+	audio_resampler_set_rates(ym2610_sample_rate, rate);
+	LOG(LOG_INFO, "sound_set_sample_rate: %u Hz\n", rate);
+}
+
+uint32_t sound_get_sample_rate(void) {
+	return audio_sample_rate;
+}
+
+void sound_set_quality(sound_quality_t quality) {
+	if (quality == audio_quality) {
+		return;
+	}
+	audio_quality = quality;
+	ym2610_skip_silent(quality == SOUND_QUALITY_SKIP_SILENT);
+	audio_cost_usec = 0;
+	audio_cost_frames = 0;
+	LOG(LOG_INFO, "sound_set_quality: %s\n", audio_quality_names[quality]);
+}
+
+static retro_time_t sound_time_usec(void) {
+	return libretroCallbacks.perf.get_time_usec != NULL ? libretroCallbacks.perf.get_time_usec() : 0;
 }
 
 void sound_start_one_frame()
 {
-	samplesThisFrameF += (double)AUDIO_SAMPLE_RATE / (double)FRAME_RATE;
-	samplesThisFrame = (uint32_t)ceil(samplesThisFrameF);
-	samplesThisFrameF -= samplesThisFrame;
+	ym2610SamplesThisFrameF += ym2610_sample_rate / FRAME_RATE;
+	ym2610SamplesThisFrame = (uint32_t)ceil(ym2610SamplesThisFrameF);
+	ym2610SamplesThisFrameF -= ym2610SamplesThisFrame;
 	audioWritePointer = 0;
 }
 
 void sound_update_current_sample()
 {
-	int32_t remaining_cycles = cpu_68k_get_remaining_master_cycles();
+	int64_t remaining_cycles = cpu_68k_get_frame_end_master_cycles() - cpu_z80_get_master_cycles();
 	uint32_t positive_remaining_cycles = remaining_cycles > 0 ? remaining_cycles : 0;
-	currentSample = (uint32_t)(round((double)(MASTER_CYCLES_PER_FRAME - positive_remaining_cycles) * (samplesThisFrame - 1) / MASTER_CYCLES_PER_FRAME));
+	currentSample = (uint32_t)(round((double)(MASTER_CYCLES_PER_FRAME - positive_remaining_cycles) * (ym2610SamplesThisFrame - 1) / MASTER_CYCLES_PER_FRAME));
 }
 
 void sound_finalize_one_frame()
 {
 //	LOG(LOG_DEBUG, "sound_finalize_one_frame current samples = %u, already wrote %u\n", currentSample, audioWritePointer);
 	// Generate YM2610 samples
-	if (audioWritePointer < samplesThisFrame)
-		ym2610_update(samplesThisFrame - audioWritePointer);
+	if (audioWritePointer < ym2610SamplesThisFrame)
+		sound_generate_samples(ym2610SamplesThisFrame - audioWritePointer);
+	
+	retro_time_t start = sound_time_usec();
+	samplesThisFrame = audio_resampler_process(ym2610_buffer, ym2610SamplesThisFrame, audioBuffer, audio_buffer_frames);
+	audio_cost_usec += sound_time_usec() - start;
 	
+	if (++audio_cost_frames == AUDIO_COST_FRAMES) {
+		if (libretroCallbacks.perf.get_time_usec != NULL) {
+			LOG(LOG_INFO, "sound: %s quality, %.3f ms per frame\n", audio_quality_names[audio_quality], (double)audio_cost_usec / 1000.0 / AUDIO_COST_FRAMES);
+		}
+		audio_cost_usec = 0;
+		audio_cost_frames = 0;
+	}
 //	LOG(LOG_DEBUG, "sound_finalize_one_frame %u samples this frame vs %u audio write pointer\n", samplesThisFrame, audioWritePointer);
 }
 
@@ -192,13 +267,73 @@ void cpu_z80_trigger_sound_command_nmi() {
 		return;
 	}
 	z80_set_irq_line(INPUT_LINE_NMI, ASSERT_LINE);
-	m68k_end_timeslice();
 }
 
 void cpu_z80_acknowledge_nmi() {
 	z80_set_irq_line(INPUT_LINE_NMI, CLEAR_LINE);
 }
 
+int64_t cpu_z80_get_master_cycles() {
+	if (z80_executing) {
+		return z80_time + z80ToMaster(z80_cycles_run());
+	}
+	return z80_time;
+}
+
+static void ym2610_fire_expired_timers(void) {
+	for (int channel = 0; channel < 2; channel++) {
+		if (ym2610_timer_active[channel] && ym2610_timer_deadline[channel] <= z80_time) {
+			ym2610_timer_active[channel] = false;
+			ym2610_timer_reload_time = ym2610_timer_deadline[channel];
+			ym2610_timerOver(channel);
+			ym2610_timer_reload_time = -1;
+		}
+	}
+}
+
+static bool ym2610_next_timer_deadline(int64_t *deadline) {
+	bool found = false;
+	for (int channel = 0; channel < 2; channel++) {
+		if (ym2610_timer_active[channel] && (!found || ym2610_timer_deadline[channel] < *deadline)) {
+			*deadline = ym2610_timer_deadline[channel];
+			found = true;
+		}
+	}
+	return found;
+}
+
+void cpu_z80_run_until(int64_t master_cycles) {
+	if (z80_executing) {
+		return;
+	}
+	
+	while (true) {
+		ym2610_fire_expired_timers();
+		
+		int32_t cycles;
+		int64_t deadline;
+		if (ym2610_next_timer_deadline(&deadline) && deadline < master_cycles) {
+			// Run up to the timer expiration, at least one cycle
+			cycles = masterToZ80((int32_t)(deadline - z80_time) + Z80_CLOCK_DIVIDER - 1);
+		}
+		else {
+			cycles = master_cycles > z80_time ? masterToZ80((int32_t)(master_cycles - z80_time)) : 0;
+			if (cycles == 0) {
+				break;
+			}
+		}
+		
+		z80_executing = true;
+		z80_slice_cycles = cycles;
+		z80_time += z80ToMaster(z80_execute(cycles));
+		z80_executing = false;
+	}
+}
+
+void cpu_z80_sync() {
+	cpu_z80_run_until(cpu_68k_get_master_cycles());
+}
+
 #pragma mark - YM2610 callbacks
 
 void ym2610_update_request(void)
@@ -206,42 +341,47 @@ void ym2610_update_request(void)
 	sound_update_current_sample();
 //	LOG(LOG_DEBUG, "YM2610UpdateRequest currentSample %u - writeptr %u \n", currentSample, audioWritePointer);
 	if (currentSample > audioWritePointer + 4)
-		ym2610_update(currentSample - audioWritePointer);
+		sound_generate_samples(currentSample - audioWritePointer);
 }
 
-void ym2610_update_audio_buffer(FMSAMPLE lt, FMSAMPLE rt)
+static void sound_generate_samples(uint32_t count)
 {
-	assert(audioWritePointer < samplesThisFrame);
-//	LOG(LOG_DEBUG, "YM2610UpdateAudioBuffer lt 0x%08X - rt 0x%08X\n", lt, rt);
-	audioBuffer[audioWritePointer * 2] = lt;
-	audioBuffer[audioWritePointer * 2 + 1] = rt;
-	audioWritePointer++;
+	assert(audioWritePointer + count <= ym2610SamplesThisFrame);
+	retro_time_t start = sound_time_usec();
+	ym2610_update(ym2610_buffer + audioWritePointer * 2, count);
+	audio_cost_usec += sound_time_usec() - start;
+	audioWritePointer += count;
 }
 
 void YM2610TimerHandler(int channel, int count, double clock)
 {
-	double      time_seconds;
-	uint32_t    time_cycles;
-
 	if (count == 0)
 	{
-		if (!channel)
-			timers.ym2610TimerA->active = false;
-		else
-			timers.ym2610TimerB->active = false;
+		ym2610_timer_active[channel] = false;
+		return;
 	}
-	else
-	{
-		time_seconds = (double)count / clock;
-		time_cycles = (uint32_t)secondsToMaster(time_seconds);
-
-		if (!channel)
-			timer_arm(timers.ym2610TimerA, time_cycles);
-		else
-			timer_arm(timers.ym2610TimerB, time_cycles);
+	
+	uint32_t time_cycles = (uint32_t)(((uint64_t)count * MASTER_CLOCK_HZ) / (uint64_t)clock);
+	ym2610_timer_active[channel] = true;
+	int64_t now = ym2610_timer_reload_time >= 0 ? ym2610_timer_reload_time : cpu_z80_get_master_cycles();
+	ym2610_timer_deadline[channel] = now + time_cycles;
+	
+	// Armed by the sound driver: end the running Z80 slice at the expiration
+	if (z80_executing) {
+		int64_t slice_end = z80_time + z80ToMaster(z80_slice_cycles);
+		if (ym2610_timer_deadline[channel] < slice_end) {
+			int32_t cycles = masterToZ80((int32_t)(slice_end - ym2610_timer_deadline[channel]));
+			z80_modify_timeslice(-cycles);
+			z80_slice_cycles -= cycles;
+		}
 	}
 }
 
+double ym2610_fm_get_time_now(void)
+{
+	return masterToSeconds(cpu_z80_get_master_cycles());
+}
+
 void YM2610IrqHandler(int irq)
 {
 	if (irq)
@@ -7,7 +7,11 @@
 #include <stdio.h>
 
 
-static uint32_t AUDIO_SAMPLE_RATE = 44100;
+typedef enum sound_quality {
+	SOUND_QUALITY_FULL,			// every voice at the YM2610 rate
+	SOUND_QUALITY_HALF_RATE,	// YM2610 at half its rate, upsampled by the resampler
+	SOUND_QUALITY_SKIP_SILENT,	// inaudible FM channels and a muted SSG aren't computed
+} sound_quality_t;
 
 extern bool z80NMIDisabled;
 extern int16_t *audioBuffer;
@@ -15,6 +19,9 @@ extern uint32_t samplesThisFrame;
 
 void sound_init(void);
 void sound_reset(void);
+void sound_set_sample_rate(uint32_t rate);	// output rate, the YM2610 always runs at its own. Dynamic rate control is left to the frontend
+uint32_t sound_get_sample_rate(void);
+void sound_set_quality(sound_quality_t quality);	// a rate change happens on the next reset
 
 void sound_start_one_frame(void);
 void sound_finalize_one_frame(void);
@@ -25,4 +32,8 @@ void cpu_z80_set_bank_offset(uint8_t bank, uint8_t offset);
 void cpu_z80_trigger_sound_command_nmi(void);
 void cpu_z80_acknowledge_nmi(void);
 
+int64_t cpu_z80_get_master_cycles(void);
+void cpu_z80_run_until(int64_t master_cycles);
+void cpu_z80_sync(void);
+
 #endif /* sound_h */
@@ -1,37 +1,148 @@
 #include "timer.h"
 
+#include <assert.h>
+
+// Active timers are kept in a binary min heap ordered by deadline
+typedef struct timer_scheduler {
+	int64_t now;
+	timer_t *heap[TIMER_SCHEDULER_CAPACITY];
+	uint32_t count;
+	uint32_t registered;
+} timer_scheduler_t;
+
+static timer_scheduler_t scheduler;
 
 #pragma mark - Private
 
-static void check_timeout(timer_t* timer) {
-	if (timer->active == false || (timer->remaining_cycles > 0))
+static bool timer_is_before(const timer_t *a, const timer_t *b) {
+	if (a->deadline != b->deadline) {
+		return a->deadline < b->deadline;
+	}
+	return a->order < b->order;
+}
+
+static void heap_set(uint32_t index, timer_t *timer) {
+	scheduler.heap[index] = timer;
+	timer->heap_index = index;
+}
+
+static void heap_sift_up(uint32_t index) {
+	timer_t *timer = scheduler.heap[index];
+	while (index > 0) {
+		uint32_t parent = (index - 1) / 2;
+		if (!timer_is_before(timer, scheduler.heap[parent])) {
+			break;
+		}
+		heap_set(index, scheduler.heap[parent]);
+		index = parent;
+	}
+	heap_set(index, timer);
+}
+
+static void heap_sift_down(uint32_t index) {
+	timer_t *timer = scheduler.heap[index];
+	for (;;) {
+		uint32_t child = index * 2 + 1;
+		if (child >= scheduler.count) {
+			break;
+		}
+		if (child + 1 < scheduler.count && timer_is_before(scheduler.heap[child + 1], scheduler.heap[child])) {
+			child++;
+		}
+		if (!timer_is_before(scheduler.heap[child], timer)) {
+			break;
+		}
+		heap_set(index, scheduler.heap[child]);
+		index = child;
+	}
+	heap_set(index, timer);
+}
+
+static void heap_remove(timer_t *timer) {
+	uint32_t index = timer->heap_index;
+	timer->heap_index = -1;
+	scheduler.count--;
+	if (index == scheduler.count) {
 		return;
+	}
+	timer_t *moved = scheduler.heap[scheduler.count];
+	heap_set(index, moved);
+	heap_sift_down(index);
+	heap_sift_up(moved->heap_index);
+}
+
+static void schedule(timer_t *timer) {
+	if (timer->heap_index < 0) {
+		assert(scheduler.count < TIMER_SCHEDULER_CAPACITY);
+		heap_set(scheduler.count, timer);
+		scheduler.count++;
+	}
+	heap_sift_down(timer->heap_index);
+	heap_sift_up(timer->heap_index);
+	timer->active = true;
 	
-	timer->active = false;
-	
-	if (timer->callback)
-		timer->callback();
+	// already late: run it now
+	if (timer->deadline <= scheduler.now) {
+		heap_remove(timer);
+		timer->active = false;
+		if (timer->callback)
+			timer->callback();
+	}
 }
 
 #pragma mark - Public
 
+void timer_register(timer_t* timer, timer_callback *callback) {
+	timer->active = false;
+	timer->deadline = 0;
+	timer->order = scheduler.registered++;
+	timer->heap_index = -1;
+	timer->callback = callback;
+}
+
 void timer_arm(timer_t* timer, const int32_t master_cycles) {
-	timer->remaining_cycles = master_cycles;
-	timer->active = true;
-	check_timeout(timer);
+	timer->deadline = scheduler.now + master_cycles;
+	schedule(timer);
 }
 
 void timer_arm_relative(timer_t* timer, const int32_t master_cycles) {
-	timer->remaining_cycles += master_cycles;
-	timer->active = true;
-	check_timeout(timer);
+	timer->deadline += master_cycles;
+	schedule(timer);
 }
 
-void timer_run(timer_t* timer, const int32_t master_cycles) {
-	if (timer->active == false) {
-		return;
+void timer_cancel(timer_t* timer) {
+	if (timer->heap_index >= 0) {
+		heap_remove(timer);
+	}
+	timer->active = false;
+}
+
+void timer_scheduler_reset(void) {
+	while (scheduler.count > 0) {
+		timer_cancel(scheduler.heap[0]);
+	}
+	scheduler.now = 0;
+}
+
+int64_t timer_scheduler_now(void) {
+	return scheduler.now;
+}
+
+bool timer_scheduler_next_deadline(int64_t *deadline) {
+	if (scheduler.count == 0) {
+		return false;
+	}
+	*deadline = scheduler.heap[0]->deadline;
+	return true;
+}
+
+void timer_scheduler_advance(const int32_t master_cycles) {
+	scheduler.now += master_cycles;
+	while (scheduler.count > 0 && scheduler.heap[0]->deadline <= scheduler.now) {
+		timer_t *timer = scheduler.heap[0];
+		heap_remove(timer);
+		timer->active = false;
+		if (timer->callback)
+			timer->callback();
 	}
-	
-	timer->remaining_cycles -= master_cycles;
-	check_timeout(timer);
 }
@@ -43,17 +43,29 @@
  Active video PAL: 320 x 256 pixels (16 pixels more on top and bottom). Ratio: 1.25:1 (5/4)
  */
 
-static const double MASTER_CLOCK = 24000000.0; //24167828.0;
-static const double M68K_CLOCK = MASTER_CLOCK / 2;
-static const double Z80_CLOCK = MASTER_CLOCK / 6;
-static const double YM2610_CLOCK = MASTER_CLOCK / 3;
-static const double PIXEL_CLOCK = MASTER_CLOCK / 4;		// 4 mckl per pixel
+// Every chip clock is the master clock through an integer divider,
+// so cycles are converted with integer math only.
+#ifdef NEOGEO_NTSC_AES_CLOCK
+#define MASTER_CLOCK_HZ		24167829
+#else
+#define MASTER_CLOCK_HZ		24000000
+#endif
+#define M68K_CLOCK_DIVIDER		2
+#define Z80_CLOCK_DIVIDER		6
+#define YM2610_CLOCK_DIVIDER	3
+#define PIXEL_CLOCK_DIVIDER		4		// 4 mckl per pixel
+
+static const double MASTER_CLOCK = (double)MASTER_CLOCK_HZ;
+static const double M68K_CLOCK = MASTER_CLOCK / M68K_CLOCK_DIVIDER;
+static const double Z80_CLOCK = MASTER_CLOCK / Z80_CLOCK_DIVIDER;
+static const double YM2610_CLOCK = MASTER_CLOCK / YM2610_CLOCK_DIVIDER;
+static const double PIXEL_CLOCK = MASTER_CLOCK / PIXEL_CLOCK_DIVIDER;
 static const int32_t HORIZONTAL_PIXELS = 384;
 static const int32_t VERTICAL_PIXELS = 264;
 static const int32_t FIRST_ACTIVE_LINE = 16;
 static const int32_t VBLANK_LINE = FIRST_ACTIVE_LINE + 224; // 240
 static const int32_t WATCHDOG_DELAY = (int32_t)(MASTER_CLOCK * 0.13516792);
-static const int32_t MASTER_CYCLES_PER_FRAME = (uint32_t)((MASTER_CLOCK / PIXEL_CLOCK) * HORIZONTAL_PIXELS * VERTICAL_PIXELS);
+static const int32_t MASTER_CYCLES_PER_FRAME = PIXEL_CLOCK_DIVIDER * HORIZONTAL_PIXELS * VERTICAL_PIXELS;
 static const double FRAME_RATE = PIXEL_CLOCK / (double)(HORIZONTAL_PIXELS * VERTICAL_PIXELS);
 
 
@@ -61,51 +73,80 @@ static inline const int32_t secondsToMaster(double value) {
 	return (int32_t)round(value * MASTER_CLOCK);
 }
 
-static inline const double masterToSeconds(int32_t value) {
+static inline const double masterToSeconds(int64_t value) {
 	return (double)value / MASTER_CLOCK;
 }
 
 static inline const int32_t m68kToMaster(int32_t value)
 {
-	return (int32_t)round((double)value * (MASTER_CLOCK / M68K_CLOCK));
+	return value * M68K_CLOCK_DIVIDER;
 }
 
 static inline const int32_t z80ToMaster(int32_t value)
 {
-	return (int32_t)round((double)value * (MASTER_CLOCK / Z80_CLOCK));
+	return value * Z80_CLOCK_DIVIDER;
 }
 
 static inline const int32_t pixelToMaster(int32_t value)
 {
-	return (int32_t)round((double)value * (MASTER_CLOCK / PIXEL_CLOCK));
+	return value * PIXEL_CLOCK_DIVIDER;
 }
 
+// Rounded up: the 68K always runs at least the requested master cycles
 static inline const int32_t masterToM68k(int32_t value)
 {
-	return (int32_t)round((double)value / (MASTER_CLOCK / M68K_CLOCK));
+	return (value + M68K_CLOCK_DIVIDER - 1) / M68K_CLOCK_DIVIDER;
 }
 
+// Truncated: callers keep the remaining master cycles for the next slice
 static inline const int32_t masterToZ80(int32_t value)
 {
-	return (int32_t)round((double)value / (MASTER_CLOCK / Z80_CLOCK));
+	return value / Z80_CLOCK_DIVIDER;
 }
 
-static inline const int32_t masterToPixel(int32_t value)
+// Converts master cycles to a clock domain, carrying the master cycles
+// left over so that no cycle is lost or invented over time.
+typedef struct clock_domain {
+	int32_t divider;
+	int32_t remainder;
+} clock_domain_t;
+
+static inline void clock_domain_reset(clock_domain_t *domain, int32_t divider)
+{
+	domain->divider = divider;
+	domain->remainder = 0;
+}
+
+static inline int32_t clock_domain_from_master(clock_domain_t *domain, int32_t master_cycles)
 {
-	return (int32_t)round((double)value / (MASTER_CLOCK / PIXEL_CLOCK));
+	int32_t cycles = master_cycles + domain->remainder;
+	int32_t ticks = cycles / domain->divider;
+	domain->remainder = cycles - ticks * domain->divider;
+	return ticks;
 }
 
 typedef void(timer_callback)(void);
 
 typedef struct timer {
 	bool active;
-	int32_t remaining_cycles;
+	int64_t deadline;			// absolute master cycles
+	uint32_t order;				// registration order, breaks deadline ties
+	int32_t heap_index;
 	timer_callback *callback;
 	uint32_t context;
 } timer_t;
 
+// Scheduler capacity: every registered timer can be armed at the same time
+#define TIMER_SCHEDULER_CAPACITY	16
+
+void timer_register(timer_t* timer, timer_callback *callback);
 void timer_arm(timer_t* timer, const int32_t master_cycles);
 void timer_arm_relative(timer_t* timer, const int32_t master_cycles);
-void timer_run(timer_t* timer, const int32_t master_cycles);
+void timer_cancel(timer_t* timer);
+
+void timer_scheduler_reset(void);
+int64_t timer_scheduler_now(void);
+bool timer_scheduler_next_deadline(int64_t *deadline);
+void timer_scheduler_advance(const int32_t master_cycles);
 
 #endif /* timer_h */
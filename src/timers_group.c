@@ -5,7 +5,6 @@
 
 #include "3rdParty/musashi/m68kcpu.h"
 #include "3rdParty/pd4990a/pd4990a.h"
-#include "3rdParty/ym/ym2610.h"
 
 
 timers_group_t timers;
@@ -13,14 +12,12 @@ timers_group_t timers;
 static timer_t  watchdog;
 static timer_t  video_timer;
 static timer_t  drawline;
-static timer_t  ym2610TimerA;
-static timer_t  ym2610TimerB;
 //static timer_t  audioCommandTimer;
 
 static const double PD4990A_CLOCK = 60;	// Custom code, need 60Hz update
 static timer_t pd4990a;		// RTC clock custom code
 
-timer_t* all_timers[7];
+static clock_domain_t pixel_clock;	// video timer counter pixels
 
 #pragma mark - Private
 
@@ -61,37 +58,31 @@ static void video_timer_callback(void) {
 	}
 }
 
-static uint32_t scanline = 0;
-static void draw_line_callback(void) {
-//	LOG(LOG_DEBUG, "draw_line_callback #%u\n", scanline);
-	if (scanline == VBLANK_LINE) {
-		vblank_callback();
-	}
-	if (scanline >= FIRST_ACTIVE_LINE && scanline < VBLANK_LINE) {
-		video_draw_empty_line(scanline);
-		
-		video_create_sprites_list(scanline);
-		video_draw_sprites(scanline);
+// Lines are drawn lazily: only when the video state they depend on is about to change,
+// when the current line is read back, or at vblank. The CPU runs in long slices in between.
+static uint32_t scanline = 0;		// next line to draw
+static int64_t next_line_time;		// master cycles at the end of that line
+
+static void draw_lines_until(int64_t master_cycles) {
+	while (next_line_time <= master_cycles) {
+		if (scanline >= FIRST_ACTIVE_LINE && scanline < VBLANK_LINE) {
+			video_draw_line(scanline);
+		}
 		
-		video_draw_fix(scanline);
-	}
-	
-	scanline++;
-	if (scanline == VERTICAL_PIXELS) {
-		LOG(LOG_DEBUG, "draw_line_callback all line done, up to 0\n");
-		scanline = 0;
+		scanline++;
+		if (scanline == VERTICAL_PIXELS) {
+			LOG(LOG_DEBUG, "draw_lines_until all line done, up to 0\n");
+			scanline = 0;
+		}
+		next_line_time += pixelToMaster(HORIZONTAL_PIXELS);
 	}
-	timer_arm_relative(&drawline, pixelToMaster(HORIZONTAL_PIXELS));
-}
-
-static void ym2610TimerACallback(void)
-{
-	ym2610_timerOver(0);
 }
 
-static void ym2610TimerBCallback(void)
-{
-	ym2610_timerOver(1);
+static void draw_line_callback(void) {
+	// Fires at the end of the vblank line, once per frame
+	draw_lines_until(drawline.deadline);
+	vblank_callback();
+	timer_arm_relative(&drawline, MASTER_CYCLES_PER_FRAME);
 }
 
 static void pd4990a_callback(void) {
@@ -103,71 +94,49 @@ static void pd4990a_callback(void) {
 #pragma mark - Public
 
 void timers_group_init() {
-	uint8_t index = 0;
-	watchdog.callback = &watchdog_callback;
+	timer_register(&watchdog, &watchdog_callback);
 	timers.watchdog = &watchdog;
-	all_timers[index] = &watchdog;
-	index++;
 	
+	timer_register(&video_timer, &video_timer_callback);
 	timers.video_timer = &video_timer;
-	video_timer.callback = &video_timer_callback;
-	all_timers[index] = &video_timer;
-	index++;
 	
+	timer_register(&drawline, &draw_line_callback);
 	timers.drawline = &drawline;
-	drawline.callback = &draw_line_callback;
-	all_timers[index] = &drawline;
-	index++;
-	
-	timers.ym2610TimerA = &ym2610TimerA;
-	ym2610TimerA.callback = &ym2610TimerACallback;
-	all_timers[index] = &ym2610TimerA;
-	index++;
-	
-	timers.ym2610TimerB = &ym2610TimerB;
-	ym2610TimerB.callback = &ym2610TimerBCallback;
-	all_timers[index] = &ym2610TimerB;
-	index++;
 	
-	pd4990a.callback = &pd4990a_callback;
+	timer_register(&pd4990a, &pd4990a_callback);
 }
 
 void timers_group_reset() {
-	timer_arm(&watchdog, WATCHDOG_DELAY);
-	watchdog.active = false;
+	timer_scheduler_reset();
+	clock_domain_reset(&pixel_clock, PIXEL_CLOCK_DIVIDER);
 	
-	timer_arm(&drawline, pixelToMaster(HORIZONTAL_PIXELS));
-	video_timer.active = false;
+	scanline = 0;
+	next_line_time = pixelToMaster(HORIZONTAL_PIXELS);
+	timer_arm(&drawline, pixelToMaster(HORIZONTAL_PIXELS) * (VBLANK_LINE + 1));
 	timer_arm(&pd4990a, MASTER_CLOCK / PD4990A_CLOCK);
-	
-	ym2610TimerA.active = false;
-	ym2610TimerB.active = false;
 }
 
 uint32_t timer_group_cycles_before_next_event() {
-	uint32_t cycles = MASTER_CYCLES_PER_FRAME;
-	for (uint8_t index = 0; index < 7; index++) {
-		timer_t *timer = all_timers[index];
-		if (timer != NULL && timer->active == true) {
-			cycles = cycles < timer->remaining_cycles ? cycles : timer->remaining_cycles;
-		}
+	int64_t deadline;
+	if (timer_scheduler_next_deadline(&deadline) == false) {
+		return MASTER_CYCLES_PER_FRAME;
 	}
-	return cycles;
+	int64_t cycles = deadline - timer_scheduler_now();
+	return cycles < MASTER_CYCLES_PER_FRAME ? (uint32_t)cycles : MASTER_CYCLES_PER_FRAME;
 }
 
 void timer_group_consume_cycles(uint32_t cycles) {
-	for (uint8_t index = 0; index < 7; index++) {
-		timer_t *timer = all_timers[index];
-		if (timer != NULL) {
-			timer_run(timer, cycles);
-		}
-	}
+	timer_scheduler_advance(cycles);
 	if (video_timer.active == true) {
-		video.timer_counter -= masterToPixel(cycles);
+		video.timer_counter -= clock_domain_from_master(&pixel_clock, cycles);
 	}
-	timer_run(&pd4990a, cycles);
+}
+
+void timer_group_sync_video() {
+	draw_lines_until(cpu_68k_get_master_cycles());
 }
 
 uint32_t timer_group_get_current_y_scanline() {
+	timer_group_sync_video();
 	return scanline;
 }
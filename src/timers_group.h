@@ -7,8 +7,6 @@ typedef struct timers_group {
 	timer_t*  watchdog;
 	timer_t*  video_timer;
 	timer_t*  drawline;
-	timer_t*  ym2610TimerA;
-	timer_t*  ym2610TimerB;
 	timer_t*  audioCommandTimer;
 	
 } timers_group_t;
@@ -20,6 +18,7 @@ void timers_group_reset(void);
 uint32_t timer_group_cycles_before_next_event(void);
 void timer_group_consume_cycles(uint32_t cycles);
 
+void timer_group_sync_video(void);
 uint32_t timer_group_get_current_y_scanline(void);
 
 #endif /* timers_group_h */
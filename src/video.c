@@ -1,5 +1,6 @@
 #include "cartridge.h"
 #include "video.h"
+#include "video_kernels.h"
 #include "endian.h"
 #include "log.h"
 #include "memory_mapping.h"
@@ -7,33 +8,38 @@
 #include "timers_group.h"
 
 #include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <string.h>
 #include <stdlib.h>
 
 
-const uint8_t X_SHRINK_TABLE[256] = {
-	0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 0,
-	0, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0,
-	0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0,
-	0, 0, 1, 0, 1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 1, 0,
-	0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 0, 0, 1, 0, 1, 0,
-	0, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
-	1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0,
-	1, 0, 1, 0, 1, 0, 1, 0, 1, 1, 1, 0, 1, 0, 1, 0,
-	1, 0, 1, 1, 1, 0, 1, 0, 1, 1, 1, 0, 1, 0, 1, 0,
-	1, 0, 1, 1, 1, 0, 1, 0, 1, 1, 1, 0, 1, 0, 1, 1,
-	1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 0, 1, 1,
-	1, 0, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 0, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
-	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1
-};
+// Horizontal shrink: source pixels kept for each zoomX value, in drawing order
+// (zoomX + 1 pixels out of 16, from the X_SHRINK_TABLE of the hardware)
+#define SHRINK_PIXELS_0(P)	P(8)
+#define SHRINK_PIXELS_1(P)	P(4) P(8)
+#define SHRINK_PIXELS_2(P)	P(4) P(8) P(12)
+#define SHRINK_PIXELS_3(P)	P(2) P(4) P(8) P(12)
+#define SHRINK_PIXELS_4(P)	P(2) P(4) P(8) P(12) P(14)
+#define SHRINK_PIXELS_5(P)	P(2) P(4) P(6) P(8) P(12) P(14)
+#define SHRINK_PIXELS_6(P)	P(2) P(4) P(6) P(8) P(10) P(12) P(14)
+#define SHRINK_PIXELS_7(P)	P(0) P(2) P(4) P(6) P(8) P(10) P(12) P(14)
+#define SHRINK_PIXELS_8(P)	P(0) P(2) P(4) P(6) P(8) P(9) P(10) P(12) P(14)
+#define SHRINK_PIXELS_9(P)	P(0) P(2) P(3) P(4) P(6) P(8) P(9) P(10) P(12) P(14)
+#define SHRINK_PIXELS_10(P)	P(0) P(2) P(3) P(4) P(6) P(8) P(9) P(10) P(12) P(14) P(15)
+#define SHRINK_PIXELS_11(P)	P(0) P(2) P(3) P(4) P(6) P(7) P(8) P(9) P(10) P(12) P(14) P(15)
+#define SHRINK_PIXELS_12(P)	P(0) P(2) P(3) P(4) P(6) P(7) P(8) P(9) P(10) P(12) P(13) P(14) P(15)
+#define SHRINK_PIXELS_13(P)	P(0) P(1) P(2) P(3) P(4) P(6) P(7) P(8) P(9) P(10) P(12) P(13) P(14) P(15)
+#define SHRINK_PIXELS_14(P)	P(0) P(1) P(2) P(3) P(4) P(6) P(7) P(8) P(9) P(10) P(11) P(12) P(13) P(14) P(15)
+#define SHRINK_PIXELS_15(P)	P(0) P(1) P(2) P(3) P(4) P(5) P(6) P(7) P(8) P(9) P(10) P(11) P(12) P(13) P(14) P(15)
+
+#define FOR_EACH_ZOOM_X(Z) \
+	Z(0) Z(1) Z(2) Z(3) Z(4) Z(5) Z(6) Z(7) Z(8) Z(9) Z(10) Z(11) Z(12) Z(13) Z(14) Z(15)
+
 
 const size_t PALETTES_COLORS_SIZE = (8 * 1024);	// 8KB palettes RAM bank equivalent with converted RGB colors
 const size_t VRAM_SIZE = (68*1024);
 static const size_t PALETTE_COLOR_NBR =	16;
-static const size_t PALETTES_PER_BANK = 256;
 static const size_t VRAM_SPRITES_LIST_SIZE = 0x80;
 
 // VRAM MAPPING - https://wiki.neogeodev.org/index.php?title=Sprites
@@ -71,6 +77,13 @@ uint16_t timer_reg_high;
 
 static uint16_t read_vram(void);
 static void write_vram(uint16_t data);
+static void write_render_vram(uint16_t address, uint16_t data);
+static void reset_sprites_index(void);
+static void init_palettes(void);
+static void reset_palettes(void);
+static void convert_dirty_palette_colors(void);
+static void render_push(uint8_t type, uint16_t argument, uint32_t value, uint8_t flags);
+static void render_publish(void);
 
 uint32_t sprite_x = 0;
 uint32_t sprite_y = 0;
@@ -79,6 +92,19 @@ uint32_t sprite_zoomY = 255;
 uint32_t sprite_clipping = 0x20;
 
 uint16_t *_vram_data;
+static uint16_t *render_vram;		// VRAM lines are drawn from: _vram_data, or the render thread copy
+
+// Auto animation state of the line being drawn
+static uint32_t render_auto_animation_counter = 0;
+static bool render_auto_animation_disabled = false;
+
+static bool render_threaded = false;
+
+// Render thread commands, see Threaded rendering
+#define RENDER_LINE				0
+#define RENDER_VRAM_WRITE		1
+#define RENDER_PALETTE_COLOR	2
+#define RENDER_PALETTE_BANK		3
 
 bool cartrigde_plugged_in = false;
 
@@ -158,6 +184,7 @@ static void vram_write_word(uint32_t offset, uint16_t data) {
 //			LOG(LOG_DEBUG, "vram_write_word REG_VRAMMOD - 0x%04X\n", data);
 			break;
 		case REG_LSPCMODE:
+			timer_group_sync_video();
 			video.auto_animation_speed = data >> 8;
 			video.auto_animation_disabled = (data & 0x0008) != 0;
 			video.timer_control = (uint8_t)(data & 0x00F0);
@@ -203,13 +230,16 @@ static void vram_write_dword(uint32_t offset, uint32_t data) {
 #pragma mark Lifecycle
 
 void video_init(void) {
-	video.palettes_colors = malloc(PALETTES_COLORS_SIZE);
+	init_palettes();
 	size_t frame_buffer_size = FRAMEBUFFER_WIDTH * FRAMEBUFFER_HEIGHT * sizeof(uint16_t);
 	video.frameBuffer = malloc(frame_buffer_size);
+	video.fixTiles = NULL;
+	video.fixUsageMap = NULL;
 	memset(video.frameBuffer, 0, frame_buffer_size);
 	memset(&(video.vram), 0, sizeof(memory_region_t));
 	video.vram.data = malloc(VRAM_SIZE);
 	_vram_data = (uint16_t *)video.vram.data;
+	render_vram = _vram_data;
 	video.vram.size = VRAM_SIZE;
 	video.vram.handlers.read_byte = &vram_read_byte;
 	video.vram.handlers.read_word = &vram_read_word;
@@ -220,11 +250,16 @@ void video_init(void) {
 }
 
 void video_reset(void) {
+	video_wait_lines();
+	
 	video.auto_animation_speed = 0;
 	video.auto_animation_counter = 0;
 	video.auto_animation_disabled = false;
 	
 	memset(_vram_data, 0, VRAM_SIZE);
+	memset(render_vram, 0, VRAM_SIZE);
+	reset_sprites_index();
+	reset_palettes();
 	vram_address = 0;
 	vram_modulo = 0;
 	
@@ -244,13 +279,6 @@ uint32_t video_reload_timer(void) {
 
 #pragma mark Palette converter
 
-void video_convert_current_palette_bank(void)
-{
-    for (uint32_t index = 0; index < PALETTE_COLOR_NBR * PALETTES_PER_BANK; index++) {
-        video_convert_current_palette_color(index);
-    }
-}
-
 /*
  Plalettes colors :
  Bit 	15 			14 	13 	12 	11 	10 	9 	8 	7 	6 	5 	4 	3 	2 	1 	0
@@ -260,14 +288,79 @@ void video_convert_current_palette_bank(void)
  Bit 	15 	14 	13 	12 	11 	10 	9 	8 	7 	6 	5 	4 	3 	2 	1 	0
  Def 	R4 	R3	R2	R1	R0	G5	G4	G3	G2	G1	G0	B4	B3	B2	B1	B0
  RGB565 G0 will always be 0 as we have less definition
+ 
+ Both banks keep their converted colors: switching banks only switches pointers.
+ Palettes RAM writes only flag their color, converted through a lookup table
+ before the next line is drawn.
  */
-void video_convert_current_palette_color(uint32_t index) {
-	uint16_t c = current_palette_ram->handlers.read_word(index*2);
-	video.palettes_colors[index] = ((c & 0x0F00) << 4) | ((c & 0x4000) >> 3) |
-									((c & 0x00F0) << 3) | ((c & 0x2000) >> 7) |
-									((c & 0x000F) << 1) | ((c & 0x1000) >> 12);
-    //TODO: b15 as dark bit
-//	LOG(LOG_DEBUG, "video_convert_current_palette_color #%i 0x%04X - 0x%04X\n", index, c, video.palettes_colors[index]);
+#define PALETTES_BANK_COLORS	4096
+#define PALETTES_DIRTY_WORDS	(PALETTES_BANK_COLORS / 64)
+
+static uint16_t *palettes_colors_lut;				// RGB565 color of each palettes RAM value
+static uint16_t *palettes_banks_colors;				// converted colors of both banks
+static uint32_t palettes_bank = 0;
+static uint64_t palettes_dirty[PALETTES_DIRTY_WORDS];	// colors of the current bank to convert
+static uint64_t palettes_dirty_words = 0;				// one bit per palettes_dirty word
+
+static void init_palettes(void) {
+	palettes_colors_lut = malloc(65536 * sizeof(uint16_t));
+	for (uint32_t c = 0; c < 65536; c++) {
+		//TODO: b15 as dark bit
+		palettes_colors_lut[c] = ((c & 0x0F00) << 4) | ((c & 0x4000) >> 3) |
+								((c & 0x00F0) << 3) | ((c & 0x2000) >> 7) |
+								((c & 0x000F) << 1) | ((c & 0x1000) >> 12);
+	}
+	palettes_banks_colors = malloc(2 * PALETTES_COLORS_SIZE);
+	reset_palettes();
+}
+
+// Palettes RAMs are cleared on reset, black converts to 0
+static void reset_palettes(void) {
+	memset(palettes_banks_colors, 0, 2 * PALETTES_COLORS_SIZE);
+	memset(palettes_dirty, 0, sizeof(palettes_dirty));
+	palettes_dirty_words = 0;
+	palettes_bank = 0;
+	video.palettes_colors = palettes_banks_colors;
+}
+
+void video_use_palette_bank(uint32_t bank) {
+	timer_group_sync_video();
+	convert_dirty_palette_colors();
+	palettes_bank = bank;
+	// Converted colors are only used to draw, by the render thread when there is one
+	if (render_threaded)
+		render_push(RENDER_PALETTE_BANK, bank, 0, 0);
+	else
+		video.palettes_colors = palettes_banks_colors + bank * PALETTES_BANK_COLORS;
+}
+
+void video_palette_color_changed(uint32_t index) {
+	// Lines up to now are drawn with the previous color
+	timer_group_sync_video();
+	palettes_dirty[index / 64] |= 1ULL << (index % 64);
+	palettes_dirty_words |= 1ULL << (index / 64);
+}
+
+static void convert_dirty_palette_colors(void) {
+	const uint16_t *palettes_ram = (const uint16_t *)current_palette_ram->data;
+	uint16_t *bank_colors = palettes_banks_colors + palettes_bank * PALETTES_BANK_COLORS;
+	
+	while (palettes_dirty_words) {
+		uint32_t word = __builtin_ctzll(palettes_dirty_words);
+		palettes_dirty_words &= palettes_dirty_words - 1;
+		uint64_t bits = palettes_dirty[word];
+		palettes_dirty[word] = 0;
+		while (bits) {
+			uint32_t index = word * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			uint16_t color = palettes_colors_lut[palettes_ram[index]];
+			if (render_threaded)
+				render_push(RENDER_PALETTE_COLOR, palettes_bank * PALETTES_BANK_COLORS + index, color, 0);
+			else
+				bank_colors[index] = color;
+//			LOG(LOG_DEBUG, "convert_dirty_palette_colors #%i 0x%04X - 0x%04X\n", index, palettes_ram[index], color);
+		}
+	}
 }
 
 #pragma mark Sprites
@@ -277,42 +370,99 @@ static inline bool isSpriteOnScanline(uint32_t scanline, uint32_t y, uint32_t cl
 	return (clipping != 0) && ((clipping >= 0x20) || ((scanline - y) & 0x1ff) < (clipping * 0x10));
 }
 
+// Sprites lines index: for each line where lists are built, one bit per visible sprite.
+// Chains (sticky sprites) get the position and size of their first sprite.
+// The index is updated from SCB3 only when it changed, so lists are built without scanning all the sprites.
+#define SPRITES_INDEX_LINES		240		// lists are built up to VBLANK_LINE
+#define SPRITES_INDEX_WORDS		6		// 64 bits words for MAX_SPRITES_PER_SCREEN sprites
+
+static uint64_t sprites_index[SPRITES_INDEX_LINES][SPRITES_INDEX_WORDS];
+static uint16_t sprites_index_y[SPRITES_INDEX_WORDS * 64];
+static uint8_t sprites_index_clipping[SPRITES_INDEX_WORDS * 64];	// 0: not visible
+static bool sprites_index_dirty = true;
+
+static void index_sprite_lines(uint16_t spriteNumber, uint32_t y, uint32_t clipping, bool visible)
+{
+	uint64_t *word = &sprites_index[0][spriteNumber / 64];
+	uint64_t bit = 1ULL << (spriteNumber % 64);
+	
+	if (clipping == 0)
+		return;
+	
+	for (uint32_t line = 0; line < SPRITES_INDEX_LINES; line++)
+	{
+		if (isSpriteOnScanline(line, y, clipping))
+		{
+			if (visible)
+				word[line * SPRITES_INDEX_WORDS] |= bit;
+			else
+				word[line * SPRITES_INDEX_WORDS] &= ~bit;
+		}
+	}
+}
+
+static void update_sprites_index(void)
+{
+	uint32_t y = 0;
+	uint32_t clipping = 0;		// sticky sprites before the first chain are not displayed
+	
+	for (uint16_t spriteNumber = 0; spriteNumber < MAX_SPRITES_PER_SCREEN; ++spriteNumber)
+	{
+		uint16_t attributes = render_vram[VRAM_SCB3_START + spriteNumber];
+		
+		if (!(attributes & SCB3_STICKY_BIT_MASK))
+		{
+			y = ((496 - (attributes >> 7)) + 16) & 0x1FF;
+			clipping = attributes & 0x3F;
+		}
+		
+		if (y == sprites_index_y[spriteNumber] && clipping == sprites_index_clipping[spriteNumber])
+			continue;
+		
+		index_sprite_lines(spriteNumber, sprites_index_y[spriteNumber], sprites_index_clipping[spriteNumber], false);
+		index_sprite_lines(spriteNumber, y, clipping, true);
+		sprites_index_y[spriteNumber] = y;
+		sprites_index_clipping[spriteNumber] = clipping;
+	}
+	sprites_index_dirty = false;
+}
+
+static void reset_sprites_index(void)
+{
+	memset(sprites_index, 0, sizeof(sprites_index));
+	memset(sprites_index_y, 0, sizeof(sprites_index_y));
+	memset(sprites_index_clipping, 0, sizeof(sprites_index_clipping));
+	sprites_index_dirty = true;
+}
+
 void video_create_sprites_list(uint32_t scanline) {
-	uint16_t* vertical_attributes_p = _vram_data + VRAM_SCB3_START;
 	uint16_t activeCount = 0;
-	uint16_t attributes;
-	uint32_t y = 0;
-	uint32_t clipping = 32;
-	bool spriteIsOnScanline = false;
 	
 	uint16_t *spriteList;
 	if (scanline & 1) {
-		spriteList = _vram_data + VRAM_SPRITES_ODD_START;
+		spriteList = render_vram + VRAM_SPRITES_ODD_START;
 	}
 	else {
-		spriteList = _vram_data + VRAM_SPRITES_EVEN_START;
+		spriteList = render_vram + VRAM_SPRITES_EVEN_START;
 	}
 	memset(spriteList, 0, sizeof(uint16_t) * VRAM_SPRITES_LIST_SIZE);
 	
-	for (uint16_t spriteNumber = 0; spriteNumber < MAX_SPRITES_PER_SCREEN; ++spriteNumber)
+	if (sprites_index_dirty)
+		update_sprites_index();
+	
+	assert(scanline < SPRITES_INDEX_LINES);
+	const uint64_t *line_sprites = sprites_index[scanline];
+	
+	// Sprites in ascending order, up to the hardware limit
+	for (uint32_t word = 0; word < SPRITES_INDEX_WORDS && activeCount < MAX_SPRITES_PER_LINE; word++)
 	{
-		attributes = *vertical_attributes_p++;
-		
-		if (!(attributes & SCB3_STICKY_BIT_MASK))
+		uint64_t bits = line_sprites[word];
+		while (bits && activeCount < MAX_SPRITES_PER_LINE)
 		{
-			y = (496 - (attributes >> 7)) + 16;
-			clipping = attributes & 0x3F;
-			spriteIsOnScanline = isSpriteOnScanline(scanline, y, clipping);
+			*spriteList++ = word * 64 + __builtin_ctzll(bits);
+			bits &= bits - 1;
+			activeCount++;
 		}
-		
-		if (!spriteIsOnScanline)
-		continue;
-		
-		*spriteList++ = spriteNumber;
-		activeCount++;
-		
-		if (activeCount >= MAX_SPRITES_PER_LINE)
-		break;
 	}
 	
 	if (scanline == 112 && debug_log_vram) {
@@ -325,43 +475,83 @@ void video_create_sprites_list(uint32_t scanline) {
 	}
 }
 
-static inline void draw_sprite_line(uint32_t zoomX, int increment, uint8_t *pixels_base,
-									const uint16_t* paletteBase, uint16_t* frameBuffer_p)
-{
-	uint64_t pixels_pair = *(uint64_t *)pixels_base;
-	uint8_t color_index = 0;
-	uint16_t shrinkX_table_index = zoomX * 16;
-	for (int i = 0; i < 16; ++i)
+// One straight-line kernel per zoomX value and direction, the pixel steps are constants
+#define SPRITE_PIXEL_FORWARD(i) \
+	color_index = (pixels_pair >> (4 * (i))) & 0x0F; \
+	if (color_index) \
+		*frameBuffer_p = paletteBase[color_index]; \
+	frameBuffer_p++;
+
+#define SPRITE_PIXEL_BACKWARD(i) \
+	color_index = (pixels_pair >> (4 * (i))) & 0x0F; \
+	if (color_index) \
+		*frameBuffer_p = paletteBase[color_index]; \
+	frameBuffer_p--;
+
+#define SPRITE_OPAQUE_PIXEL_FORWARD(i) \
+	color_index = (pixels_pair >> (4 * (i))) & 0x0F; \
+	*frameBuffer_p = paletteBase[color_index]; \
+	frameBuffer_p++;
+
+#define SPRITE_OPAQUE_PIXEL_BACKWARD(i) \
+	color_index = (pixels_pair >> (4 * (i))) & 0x0F; \
+	*frameBuffer_p = paletteBase[color_index]; \
+	frameBuffer_p--;
+
+#define SPRITE_LINE_KERNEL(name, zoom, PIXEL) \
+static void name##_##zoom(uint64_t pixels_pair, const uint16_t* paletteBase, uint16_t* frameBuffer_p) \
+{ \
+	uint32_t color_index; \
+	SHRINK_PIXELS_##zoom(PIXEL) \
+}
+
+#define SPRITE_LINE_KERNELS(zoom) \
+	SPRITE_LINE_KERNEL(draw_sprite_line, zoom, SPRITE_PIXEL_FORWARD) \
+	SPRITE_LINE_KERNEL(draw_sprite_line_flipped, zoom, SPRITE_PIXEL_BACKWARD) \
+	SPRITE_LINE_KERNEL(copy_sprite_line, zoom, SPRITE_OPAQUE_PIXEL_FORWARD) \
+	SPRITE_LINE_KERNEL(copy_sprite_line_flipped, zoom, SPRITE_OPAQUE_PIXEL_BACKWARD)
+
+FOR_EACH_ZOOM_X(SPRITE_LINE_KERNELS)
+
+typedef void (*sprite_line_kernel_t)(uint64_t pixels_pair, const uint16_t* paletteBase, uint16_t* frameBuffer_p);
+
+#define SPRITE_LINE_KERNEL_ENTRY(zoom)					draw_sprite_line_##zoom,
+#define SPRITE_LINE_FLIPPED_KERNEL_ENTRY(zoom)			draw_sprite_line_flipped_##zoom,
+#define SPRITE_OPAQUE_LINE_KERNEL_ENTRY(zoom)			copy_sprite_line_##zoom,
+#define SPRITE_OPAQUE_LINE_FLIPPED_KERNEL_ENTRY(zoom)	copy_sprite_line_flipped_##zoom,
+#define SHRINK_PIXEL_ENTRY(i)							i,
+#define SHRINK_PIXELS_ENTRY(zoom)						{ SHRINK_PIXELS_##zoom(SHRINK_PIXEL_ENTRY) },
+
+// [opaque][flipped][zoomX]
+static const sprite_line_kernel_t sprite_line_kernels[2][2][16] = {
 	{
-		if (X_SHRINK_TABLE[shrinkX_table_index + i])
-		{
-			color_index = (pixels_pair >> (4 * i)) & 0x0F;
-			if (color_index)
-			{
-				*frameBuffer_p = paletteBase[color_index];
-			}
-			frameBuffer_p += increment;
-		}
+		{ FOR_EACH_ZOOM_X(SPRITE_LINE_KERNEL_ENTRY) },
+		{ FOR_EACH_ZOOM_X(SPRITE_LINE_FLIPPED_KERNEL_ENTRY) }
+	},
+	{
+		{ FOR_EACH_ZOOM_X(SPRITE_OPAQUE_LINE_KERNEL_ENTRY) },
+		{ FOR_EACH_ZOOM_X(SPRITE_OPAQUE_LINE_FLIPPED_KERNEL_ENTRY) }
 	}
-}
+};
+
+static const uint8_t shrink_pixels[16][16] = {
+	FOR_EACH_ZOOM_X(SHRINK_PIXELS_ENTRY)
+};
 
 static inline void draw_sprite_line_clipped(uint32_t zoomX, int increment, uint8_t *pixels_base, const uint16_t* paletteBase,
 											uint16_t* frameBuffer_p, const uint16_t* low, const uint16_t* high)
 {
 	uint64_t pixels_pair = *(uint64_t *)pixels_base;
 	uint8_t color_index = 0;
-	uint16_t shrinkX_table_index = zoomX * 16;
-	for (int i = 0; i < 16; ++i)
+	const uint8_t *pixels = shrink_pixels[zoomX];
+	for (uint32_t i = 0; i <= zoomX; ++i)
 	{
-		if (X_SHRINK_TABLE[shrinkX_table_index + i])
+		color_index = (pixels_pair >> (4 * pixels[i])) & 0x0F;
+		if (color_index && (frameBuffer_p >= low) && (frameBuffer_p < high))
 		{
-			color_index = (pixels_pair >> (4 * i)) & 0x0F;
-			if (color_index && (frameBuffer_p >= low) && (frameBuffer_p < high))
-			{
-				*frameBuffer_p = paletteBase[color_index];
-			}
-			frameBuffer_p += increment;
+			*frameBuffer_p = paletteBase[color_index];
 		}
+		frameBuffer_p += increment;
 	}
 }
 
@@ -405,21 +595,30 @@ void video_draw_sprite(uint32_t spriteNumber, uint32_t x, uint32_t y, uint32_t z
 		tileNumber ^= 0x1f;
 	}
 	
-	uint32_t tileIndex = _vram_data[spriteNumber * 64 + tileNumber * 2];
-	uint32_t tileControl = _vram_data[spriteNumber * 64 + tileNumber * 2 + 1];
+	uint32_t tileIndex = render_vram[spriteNumber * 64 + tileNumber * 2];
+	uint32_t tileControl = render_vram[spriteNumber * 64 + tileNumber * 2 + 1];
 	tileIndex += (tileControl & 0x00F0) << 12;
 
 	if (tileControl & 2)
 	tileLine ^= 0x0F;
 
-	if (video.auto_animation_disabled == false)
+	if (render_auto_animation_disabled == false)
 	{
 		if (tileControl & 0x0008)
-			tileIndex = (tileIndex & ~0x07) | (video.auto_animation_counter & 0x07);
+			tileIndex = (tileIndex & ~0x07) | (render_auto_animation_counter & 0x07);
 		else if (tileControl & 0x0004)
-			tileIndex = (tileIndex & ~0x03) | (video.auto_animation_counter & 0x03);
+			tileIndex = (tileIndex & ~0x03) | (render_auto_animation_counter & 0x03);
 	}
 	
+	uint32_t pixels_offset = (tileIndex * CHARACTER_TILE_BYTES) + (tileLine * 8);
+	assert(pixels_offset < serialized_c_roms.size);
+	
+	// Empty lines are skipped without reading their pixels
+	uint32_t line_usage = (characters_lines_usage[tileIndex] >> (tileLine * 2)) & 0x03;
+	if (line_usage == CHARACTER_LINE_TRANSPARENT)
+		return;
+	bool opaque = line_usage == CHARACTER_LINE_OPAQUE;
+	
 //	if (spriteNumber == 253) {
 //		LOG(LOG_DEBUG, "video_draw_sprite scanline %u, spriteLine %u, tileNumber %u, tileLine %u, tileIndex %04X, tileControl %04X\n", scanline, spriteLine, tileNumber, tileLine, tileIndex, tileControl);
 //	}
@@ -444,8 +643,6 @@ void video_draw_sprite(uint32_t spriteNumber, uint32_t x, uint32_t y, uint32_t z
 	}
 
 	const uint16_t* paletteBase = video.palettes_colors + ((tileControl >> 8) * PALETTE_COLOR_NBR);
-	uint32_t pixels_offset = (tileIndex * CHARACTER_TILE_BYTES) + (tileLine * 8);
-	assert(pixels_offset < serialized_c_roms.size);
 	uint8_t *pixels_base = serialized_c_roms.data + pixels_offset;
 
 	if (clipped)
@@ -459,8 +656,18 @@ void video_draw_sprite(uint32_t spriteNumber, uint32_t x, uint32_t y, uint32_t z
 							  video.frameBuffer + ((scanline - 16) * FRAMEBUFFER_WIDTH),
 							  video.frameBuffer + ((scanline - 15) * FRAMEBUFFER_WIDTH));
 	}
+	else if (zoomX == 15)
+	{
+		// Full width lines go through the SIMD kernels
+		uint64_t pixels = *(uint64_t *)pixels_base;
+		video_pixels_kernel_t kernel = opaque ? video_copy_pixels_16 : video_draw_pixels_16;
+		if (increment < 0)
+			kernel(video_reverse_pixels_16(pixels), paletteBase, frameBufferPtr - 15);
+		else
+			kernel(pixels, paletteBase, frameBufferPtr);
+	}
 	else
-		draw_sprite_line(zoomX, increment, pixels_base, paletteBase, frameBufferPtr);
+		sprite_line_kernels[opaque][increment < 0][zoomX](*(uint64_t *)pixels_base, paletteBase, frameBufferPtr);
 }
 
 void video_draw_sprites(uint32_t scanline)
@@ -471,10 +678,10 @@ void video_draw_sprites(uint32_t scanline)
 	
 	uint16_t *spriteList;
 	if (scanline & 1) {
-		spriteList = _vram_data + VRAM_SPRITES_ODD_START;
+		spriteList = render_vram + VRAM_SPRITES_ODD_START;
 	}
 	else {
-		spriteList = _vram_data + VRAM_SPRITES_EVEN_START;
+		spriteList = render_vram + VRAM_SPRITES_EVEN_START;
 	}
 	
 	for (uint16_t currentSprite = 0; currentSprite < VRAM_SPRITES_LIST_SIZE; currentSprite++)
@@ -483,8 +690,8 @@ void video_draw_sprites(uint32_t scanline)
 		if (!spriteNumber)
 			break;
 		
-		uint16_t sprite_shrink_coefs = _vram_data[VRAM_SCB2_START + spriteNumber];
-		uint16_t sprite_vertical_pos = _vram_data[VRAM_SCB3_START + spriteNumber];
+		uint16_t sprite_shrink_coefs = render_vram[VRAM_SCB2_START + spriteNumber];
+		uint16_t sprite_vertical_pos = render_vram[VRAM_SCB3_START + spriteNumber];
 		
 		if (sprite_vertical_pos & SCB3_STICKY_BIT_MASK)
 		{
@@ -493,7 +700,7 @@ void video_draw_sprites(uint32_t scanline)
 		}
 		else
 		{
-			uint16_t sprite_horizontal_pos = _vram_data[VRAM_SCB4_START + spriteNumber];
+			uint16_t sprite_horizontal_pos = render_vram[VRAM_SCB4_START + spriteNumber];
 			sprite_zoomY = sprite_shrink_coefs & SCB2_VERTICAL_SHRINK_MASK;
 			sprite_zoomX = (sprite_shrink_coefs & SCB2_HORIZONTAL_SHRINK_MASK) >> 8;
 			sprite_clipping = sprite_vertical_pos & SCB3_VERTICAL_SPRITE_SIZE_MASK;
@@ -532,49 +739,95 @@ static const uint16_t FIX_ROM_BYTES_PER_TILE = 32;		// 8*8 pixels * 4 bits = 32
   		16 - 1E - 06 - 0E
   		17 - 1F - 07 - 0F
  
- So to find our scanline to draw, we need to advance for tile address (scanline % 8) bytes
+ So to find our scanline to draw, we need to advance for tile address (scanline % 8) bytes.
+ Tiles are decoded once in video_update_fix_tiles().
  */
 static const uint8_t fix_framebuffer_offset_mapping[4] = {0x10, 0x18, 0x00, 0x08};
 
+#define FIX_TILE_MIXED			0
+#define FIX_TILE_TRANSPARENT	1
+#define FIX_TILE_OPAQUE			2
+
+static size_t fix_tiles_count = 0;
+
+// Decodes the current fix ROM in lines of 8 pixels, left pixel in the low nibble,
+// and flags the tiles that can be skipped or drawn without transparency.
+void video_update_fix_tiles(void) {
+	video_wait_lines();
+	
+	free(video.fixTiles);
+	free(video.fixUsageMap);
+	video.fixTiles = NULL;
+	video.fixUsageMap = NULL;
+	fix_tiles_count = 0;
+	
+	if (current_fix_rom == NULL || current_fix_rom->data == NULL) {
+		return;
+	}
+	
+	fix_tiles_count = current_fix_rom->size / FIX_ROM_BYTES_PER_TILE;
+	video.fixTiles = malloc(fix_tiles_count * FIX_TILE_PIXELS_HEIGHT * sizeof(uint32_t));
+	video.fixUsageMap = malloc(fix_tiles_count);
+	
+	for (size_t tile_number = 0; tile_number < fix_tiles_count; tile_number++) {
+		const uint8_t* tileBase = current_fix_rom->data + tile_number * FIX_ROM_BYTES_PER_TILE;
+		uint32_t* lines = video.fixTiles + tile_number * FIX_TILE_PIXELS_HEIGHT;
+		bool transparent = true;
+		bool opaque = true;
+		
+		for (uint8_t line = 0; line < FIX_TILE_PIXELS_HEIGHT; line++) {
+			uint32_t pixels = 0;
+			for (uint8_t index = 0; index < 4; index++) {
+				pixels |= (uint32_t)tileBase[fix_framebuffer_offset_mapping[index] + line] << (index * 8);
+			}
+			lines[line] = pixels;
+			
+			for (uint8_t pixel = 0; pixel < 8; pixel++) {
+				if ((pixels >> (pixel * 4)) & 0x0F) {
+					transparent = false;
+				}
+				else {
+					opaque = false;
+				}
+			}
+		}
+		
+		video.fixUsageMap[tile_number] = transparent ? FIX_TILE_TRANSPARENT : (opaque ? FIX_TILE_OPAQUE : FIX_TILE_MIXED);
+	}
+}
+
 // Note: scanline between 16 and 240!
 void video_draw_fix(uint32_t scanline) {
-	uint16_t* videoRamPtr = _vram_data + VRAM_FIXMAP_START;
+	uint16_t* videoRamPtr = render_vram + VRAM_FIXMAP_START;
 	videoRamPtr += (scanline / FIX_TILE_PIXELS_HEIGHT);
 	uint16_t* frameBufferPtr = video.frameBuffer + ((scanline - 16) * FRAMEBUFFER_WIDTH);
+	uint32_t tile_line = scanline % FIX_TILE_PIXELS_HEIGHT;
+	
+	if (video.fixTiles == NULL) {
+		return;
+	}
 	
 	for (uint8_t fix_column_index = 0; fix_column_index < FIX_TILES_PER_LINE; fix_column_index++)
 	{
 		uint16_t fix = *videoRamPtr;
 		uint16_t palette_number = (fix & 0xF000) >> 12;
 		uint16_t tile_number = fix & 0x0FFF;
-		assert((tile_number + 1) * FIX_ROM_BYTES_PER_TILE <= current_fix_rom->size);
-		
-//		if (0) {	//TODO
-//			// Do not display transparent tiles
-//			frameBufferPtr += FIX_TILE_PIXELS_WIDTH;
-//			continue;
-//		}
+		assert(tile_number < fix_tiles_count);
 		
-		uint8_t* fixBase = current_fix_rom->data + ((tile_number * FIX_ROM_BYTES_PER_TILE) + (scanline % FIX_TILE_PIXELS_HEIGHT));
-		uint16_t* colorsBase = video.palettes_colors + (palette_number * PALETTE_COLOR_NBR);
-		
-		for (uint8_t index = 0; index < 4; index++) {
-			uint8_t offset = fix_framebuffer_offset_mapping[index];
-			uint8_t pixel_pair = fixBase[offset];
-			uint8_t pixel_left_color_index = pixel_pair & 0x0F;
-			uint8_t pixel_right_color_index = pixel_pair >> 4;
+		uint8_t usage = video.fixUsageMap[tile_number];
+		if (usage != FIX_TILE_TRANSPARENT) {
+			uint32_t pixels = video.fixTiles[tile_number * FIX_TILE_PIXELS_HEIGHT + tile_line];
+			uint16_t* colorsBase = video.palettes_colors + (palette_number * PALETTE_COLOR_NBR);
 			
-			if (pixel_left_color_index) {
-				*frameBufferPtr = colorsBase[pixel_left_color_index];
+			if (usage == FIX_TILE_OPAQUE) {
+				video_copy_pixels_8(pixels, colorsBase, frameBufferPtr);
 			}
-			frameBufferPtr++;
-			
-			if (pixel_right_color_index) {
-				*frameBufferPtr = colorsBase[pixel_right_color_index];
+			else if (pixels) {
+				video_draw_pixels_8(pixels, colorsBase, frameBufferPtr);
 			}
-			frameBufferPtr++;
 		}
 		
+		frameBufferPtr += 8;
 		videoRamPtr += FIX_TILES_PER_COLUMN;
 	}
 }
@@ -594,14 +847,197 @@ void video_draw_empty_line(uint32_t scanline) {
 	}
 }
 
+#pragma mark - Threaded rendering
+
+/*
+ *	Lines can be drawn by a render thread while the CPUs emulation goes on.
+ *	The emulation thread queues the lines to draw along with the VRAM writes and
+ *	converted colors in between, in order, and the render thread replays them on its
+ *	own VRAM copy: each line sees the exact VRAM and palettes state it would inline.
+ */
+
+#define RENDER_RING_SIZE	(1 << 16)	// commands, VRAM writes included: a few frames worth
+#define RENDER_LINES_BATCH	8
+
+typedef struct render_command {
+	uint8_t type;
+	uint8_t auto_animation_disabled;
+	uint16_t argument;					// scanline, VRAM address, palette color index or bank
+	uint32_t value;						// auto animation counter, VRAM word or color
+} render_command_t;
+
+static render_command_t *render_ring = NULL;
+static uint32_t render_ring_next = 0;		// next command pushed, emulation thread only
+static uint32_t render_ring_write = 0;		// commands published to the render thread
+static atomic_uint render_ring_read = 0;	// commands done by the render thread
+static bool render_stop = false;
+
+static pthread_t render_thread;
+static pthread_mutex_t render_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t render_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t render_done = PTHREAD_COND_INITIALIZER;
+
+static void render_line(uint32_t scanline, uint32_t auto_animation_counter, bool auto_animation_disabled) {
+	render_auto_animation_counter = auto_animation_counter;
+	render_auto_animation_disabled = auto_animation_disabled;
+	
+	video_draw_empty_line(scanline);
+	
+	video_create_sprites_list(scanline);
+	video_draw_sprites(scanline);
+	
+	video_draw_fix(scanline);
+}
+
+static void *render_thread_main(void *arg) {
+	pthread_mutex_lock(&render_mutex);
+	for (;;) {
+		uint32_t read = atomic_load(&render_ring_read);
+		uint32_t write = render_ring_write;
+		if (read == write) {
+			if (render_stop)
+				break;
+			pthread_cond_wait(&render_work, &render_mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&render_mutex);
+		
+		for (; read != write; read++) {
+			const render_command_t *command = &render_ring[read & (RENDER_RING_SIZE - 1)];
+			switch (command->type) {
+				case RENDER_LINE:
+					render_line(command->argument, command->value, command->auto_animation_disabled);
+					break;
+				case RENDER_VRAM_WRITE:
+					write_render_vram(command->argument, (uint16_t)command->value);
+					break;
+				case RENDER_PALETTE_COLOR:
+					palettes_banks_colors[command->argument] = (uint16_t)command->value;
+					break;
+				case RENDER_PALETTE_BANK:
+					video.palettes_colors = palettes_banks_colors + command->argument * PALETTES_BANK_COLORS;
+					break;
+			}
+		}
+		
+		pthread_mutex_lock(&render_mutex);
+		atomic_store(&render_ring_read, read);
+		pthread_cond_signal(&render_done);
+	}
+	pthread_mutex_unlock(&render_mutex);
+	return NULL;
+}
+
+static void render_publish(void) {
+	if (render_threaded == false || render_ring_write == render_ring_next)
+		return;
+	pthread_mutex_lock(&render_mutex);
+	render_ring_write = render_ring_next;
+	pthread_cond_signal(&render_work);
+	pthread_mutex_unlock(&render_mutex);
+}
+
+// Waits until no more than pending commands are left to the render thread
+static void render_wait(uint32_t pending) {
+	render_publish();
+	pthread_mutex_lock(&render_mutex);
+	while (render_ring_next - atomic_load(&render_ring_read) > pending) {
+		pthread_cond_wait(&render_done, &render_mutex);
+	}
+	pthread_mutex_unlock(&render_mutex);
+}
+
+static void render_push(uint8_t type, uint16_t argument, uint32_t value, uint8_t flags) {
+	if (render_ring_next - atomic_load(&render_ring_read) == RENDER_RING_SIZE) {
+		render_wait(RENDER_RING_SIZE / 2);
+	}
+	render_command_t *command = &render_ring[render_ring_next & (RENDER_RING_SIZE - 1)];
+	command->type = type;
+	command->auto_animation_disabled = flags;
+	command->argument = argument;
+	command->value = value;
+	render_ring_next++;
+}
+
+void video_draw_line(uint32_t scanline) {
+	if (palettes_dirty_words)
+		convert_dirty_palette_colors();
+	
+	if (render_threaded) {
+		render_push(RENDER_LINE, scanline, video.auto_animation_counter, video.auto_animation_disabled);
+		// Lines are handed over by batches, to wake the render thread less often
+		if ((scanline % RENDER_LINES_BATCH) == RENDER_LINES_BATCH - 1)
+			render_publish();
+	}
+	else {
+		render_line(scanline, video.auto_animation_counter, video.auto_animation_disabled);
+	}
+}
+
+void video_wait_lines(void) {
+	if (render_threaded) {
+		render_wait(0);
+	}
+}
+
+void video_set_threaded_rendering(bool enabled) {
+	if (enabled == render_threaded) {
+		return;
+	}
+	
+	if (enabled == false) {
+		video_wait_lines();
+		pthread_mutex_lock(&render_mutex);
+		render_stop = true;
+		pthread_cond_signal(&render_work);
+		pthread_mutex_unlock(&render_mutex);
+		pthread_join(render_thread, NULL);
+		render_threaded = false;
+		
+		// Brings back the sprites lists
+		memcpy(_vram_data, render_vram, VRAM_SIZE);
+		free(render_vram);
+		free(render_ring);
+		render_vram = _vram_data;
+		render_ring = NULL;
+		LOG(LOG_INFO, "video_set_threaded_rendering: lines drawn inline\n");
+		return;
+	}
+	
+	render_ring = malloc(RENDER_RING_SIZE * sizeof(render_command_t));
+	render_vram = malloc(VRAM_SIZE);
+	memcpy(render_vram, _vram_data, VRAM_SIZE);
+	render_ring_next = 0;
+	render_ring_write = 0;
+	atomic_store(&render_ring_read, 0);
+	render_stop = false;
+	if (pthread_create(&render_thread, NULL, render_thread_main, NULL) != 0) {
+		LOG(LOG_ERROR, "video_set_threaded_rendering: can't start the render thread\n");
+		free(render_vram);
+		free(render_ring);
+		render_vram = _vram_data;
+		render_ring = NULL;
+		return;
+	}
+	render_threaded = true;
+	LOG(LOG_INFO, "video_set_threaded_rendering: lines drawn on a render thread\n");
+}
+
 #pragma mark - Private
 
 static uint16_t read_vram() {
+	timer_group_sync_video();
 	assert(vram_address <= VRAM_UNUSED_END);
+	// Sprites lists are built by the render thread in its own VRAM
+	if (render_threaded && vram_address >= VRAM_SPRITES_EVEN_START && vram_address <= VRAM_SPRITES_ODD_END) {
+		video_wait_lines();
+		return render_vram[vram_address];
+	}
 	return _vram_data[vram_address];
 }
 
 static void write_vram(uint16_t data) {
+	timer_group_sync_video();
 	
 	if (debug_log_vram) {
 //		LOG(LOG_DEBUG, "write_vram at 0x%08X - 0x%04X\n", vram_address, data);
@@ -653,6 +1089,17 @@ static void write_vram(uint16_t data) {
 		|| vram_address > VRAM_UNUSED_END) {
 		return;
 	}
+	if (render_threaded)
+		render_push(RENDER_VRAM_WRITE, vram_address, data, 0);
+	else
+		write_render_vram(vram_address, data);
 	_vram_data[vram_address] = data;
 	vram_address += vram_modulo;
 }
+
+static void write_render_vram(uint16_t address, uint16_t data) {
+	if (address >= VRAM_SCB3_START && address <= VRAM_SCB3_END && render_vram[address] != data) {
+		sprites_index_dirty = true;
+	}
+	render_vram[address] = data;
+}
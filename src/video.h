@@ -3,6 +3,7 @@
 
 #include "memory_region.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 
 static const uint32_t FRAMEBUFFER_WIDTH = 320;
@@ -18,7 +19,8 @@ static const uint16_t MAX_SPRITES_PER_LINE = 96;
 
 typedef struct video {
 	uint16_t* palettes_colors;
-	uint8_t* fixUsageMap;
+	uint32_t* fixTiles;			// decoded fix ROM: one 8 pixels line per word, see video_kernels.h
+	uint8_t* fixUsageMap;		// per fix tile: mixed, fully transparent or fully opaque
 	uint16_t* frameBuffer;
 	memory_region_t vram;		// VRAM - https://wiki.neogeodev.org/index.php?title=VRAM
 	uint32_t timer_counter;
@@ -39,15 +41,20 @@ uint32_t video_reload_timer(void);
 
 #pragma mark - Drawing
 
+void video_draw_line(uint32_t scanline);		// inline, or queued to the render thread
+void video_wait_lines(void);					// until all queued lines are drawn
+void video_set_threaded_rendering(bool enabled);
+
 void video_draw_empty_line(uint32_t scanline);
 void video_draw_fix(uint32_t scanline);
+void video_update_fix_tiles(void);
 
 void video_create_sprites_list(uint32_t scanline);
 void video_draw_sprites(uint32_t scanline);
 
 #pragma mark - Palettes helpers
 
-void video_convert_current_palette_bank(void);
-void video_convert_current_palette_color(uint32_t index);
+void video_use_palette_bank(uint32_t bank);
+void video_palette_color_changed(uint32_t index);	// in the current bank
 
 #endif /* video */
@@ -0,0 +1,284 @@
+#include "video_kernels.h"
+#include "libretro.h"
+#include "log.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define VIDEO_KERNELS_SSE2
+#include <emmintrin.h>
+#if defined(__GNUC__)
+#define VIDEO_KERNELS_SSSE3
+#include <tmmintrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define VIDEO_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+#pragma mark - Scalar
+
+static void draw_pixels_16_scalar(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	for (int i = 0; i < 16; ++i)
+	{
+		uint8_t color_index = (pixels >> (4 * i)) & 0x0F;
+		if (color_index)
+			frame_buffer[i] = palette[color_index];
+	}
+}
+
+static void draw_pixels_8_scalar(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	for (int i = 0; i < 8; ++i)
+	{
+		uint8_t color_index = (pixels >> (4 * i)) & 0x0F;
+		if (color_index)
+			frame_buffer[i] = palette[color_index];
+	}
+}
+
+static void copy_pixels_8_scalar(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	for (int i = 0; i < 8; ++i)
+		frame_buffer[i] = palette[(pixels >> (4 * i)) & 0x0F];
+}
+
+static void copy_pixels_16_scalar(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	for (int i = 0; i < 16; ++i)
+		frame_buffer[i] = palette[(pixels >> (4 * i)) & 0x0F];
+}
+
+#pragma mark - SSE2
+
+#ifdef VIDEO_KERNELS_SSE2
+
+// One byte per pixel, in pixels order
+static inline __m128i sse2_unpack_indexes(uint64_t pixels)
+{
+	const __m128i nibble_mask = _mm_set1_epi8(0x0F);
+	__m128i packed = _mm_set_epi64x(0, (int64_t)pixels);
+	return _mm_unpacklo_epi8(_mm_and_si128(packed, nibble_mask),
+							 _mm_and_si128(_mm_srli_epi16(packed, 4), nibble_mask));
+}
+
+// Keeps the frame buffer where the byte mask is set, stores the colors elsewhere
+static inline void sse2_blend_store(uint16_t* frame_buffer, __m128i colors, __m128i transparent)
+{
+	__m128i background = _mm_loadu_si128((const __m128i *)frame_buffer);
+	__m128i blended = _mm_or_si128(_mm_and_si128(transparent, background), _mm_andnot_si128(transparent, colors));
+	_mm_storeu_si128((__m128i *)frame_buffer, blended);
+}
+
+static void draw_pixels_16_sse2(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	__m128i transparent = _mm_cmpeq_epi8(sse2_unpack_indexes(pixels), _mm_setzero_si128());
+
+	// No byte shuffle before SSSE3: colors are looked up one by one, without branches
+	uint16_t colors[16];
+	for (int i = 0; i < 16; ++i)
+		colors[i] = palette[(pixels >> (4 * i)) & 0x0F];
+
+	sse2_blend_store(frame_buffer, _mm_loadu_si128((const __m128i *)colors), _mm_unpacklo_epi8(transparent, transparent));
+	sse2_blend_store(frame_buffer + 8, _mm_loadu_si128((const __m128i *)(colors + 8)), _mm_unpackhi_epi8(transparent, transparent));
+}
+
+static void draw_pixels_8_sse2(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	__m128i transparent = _mm_cmpeq_epi8(sse2_unpack_indexes(pixels), _mm_setzero_si128());
+
+	uint16_t colors[8];
+	for (int i = 0; i < 8; ++i)
+		colors[i] = palette[(pixels >> (4 * i)) & 0x0F];
+
+	sse2_blend_store(frame_buffer, _mm_loadu_si128((const __m128i *)colors), _mm_unpacklo_epi8(transparent, transparent));
+}
+
+static void copy_pixels_8_sse2(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	uint16_t colors[8];
+	for (int i = 0; i < 8; ++i)
+		colors[i] = palette[(pixels >> (4 * i)) & 0x0F];
+
+	_mm_storeu_si128((__m128i *)frame_buffer, _mm_loadu_si128((const __m128i *)colors));
+}
+
+static void copy_pixels_16_sse2(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	uint16_t colors[16];
+	for (int i = 0; i < 16; ++i)
+		colors[i] = palette[(pixels >> (4 * i)) & 0x0F];
+
+	_mm_storeu_si128((__m128i *)frame_buffer, _mm_loadu_si128((const __m128i *)colors));
+	_mm_storeu_si128((__m128i *)(frame_buffer + 8), _mm_loadu_si128((const __m128i *)(colors + 8)));
+}
+
+#endif /* VIDEO_KERNELS_SSE2 */
+
+#pragma mark - SSSE3
+
+#ifdef VIDEO_KERNELS_SSSE3
+
+// The palette is split into low and high bytes tables, then both are shuffled by the indexes
+#define SSSE3_LOOKUP_COLORS(palette, indexes, colors_low, colors_high) \
+	const __m128i byte_mask = _mm_set1_epi16(0x00FF); \
+	__m128i palette_0 = _mm_loadu_si128((const __m128i *)(palette)); \
+	__m128i palette_1 = _mm_loadu_si128((const __m128i *)((palette) + 8)); \
+	__m128i palette_low = _mm_packus_epi16(_mm_and_si128(palette_0, byte_mask), _mm_and_si128(palette_1, byte_mask)); \
+	__m128i palette_high = _mm_packus_epi16(_mm_srli_epi16(palette_0, 8), _mm_srli_epi16(palette_1, 8)); \
+	__m128i colors_low = _mm_shuffle_epi8(palette_low, indexes); \
+	__m128i colors_high = _mm_shuffle_epi8(palette_high, indexes);
+
+__attribute__((target("ssse3")))
+static void draw_pixels_16_ssse3(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	__m128i indexes = sse2_unpack_indexes(pixels);
+	__m128i transparent = _mm_cmpeq_epi8(indexes, _mm_setzero_si128());
+	SSSE3_LOOKUP_COLORS(palette, indexes, colors_low, colors_high)
+
+	sse2_blend_store(frame_buffer, _mm_unpacklo_epi8(colors_low, colors_high), _mm_unpacklo_epi8(transparent, transparent));
+	sse2_blend_store(frame_buffer + 8, _mm_unpackhi_epi8(colors_low, colors_high), _mm_unpackhi_epi8(transparent, transparent));
+}
+
+__attribute__((target("ssse3")))
+static void draw_pixels_8_ssse3(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	__m128i indexes = sse2_unpack_indexes(pixels & 0xFFFFFFFF);
+	__m128i transparent = _mm_cmpeq_epi8(indexes, _mm_setzero_si128());
+	SSSE3_LOOKUP_COLORS(palette, indexes, colors_low, colors_high)
+
+	sse2_blend_store(frame_buffer, _mm_unpacklo_epi8(colors_low, colors_high), _mm_unpacklo_epi8(transparent, transparent));
+}
+
+__attribute__((target("ssse3")))
+static void copy_pixels_8_ssse3(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	__m128i indexes = sse2_unpack_indexes(pixels & 0xFFFFFFFF);
+	SSSE3_LOOKUP_COLORS(palette, indexes, colors_low, colors_high)
+
+	_mm_storeu_si128((__m128i *)frame_buffer, _mm_unpacklo_epi8(colors_low, colors_high));
+}
+
+__attribute__((target("ssse3")))
+static void copy_pixels_16_ssse3(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	__m128i indexes = sse2_unpack_indexes(pixels);
+	SSSE3_LOOKUP_COLORS(palette, indexes, colors_low, colors_high)
+
+	_mm_storeu_si128((__m128i *)frame_buffer, _mm_unpacklo_epi8(colors_low, colors_high));
+	_mm_storeu_si128((__m128i *)(frame_buffer + 8), _mm_unpackhi_epi8(colors_low, colors_high));
+}
+
+#endif /* VIDEO_KERNELS_SSSE3 */
+
+#pragma mark - NEON
+
+#ifdef VIDEO_KERNELS_NEON
+
+// One byte per pixel, in pixels order
+static inline uint8x8x2_t neon_unpack_indexes(uint64_t pixels)
+{
+	uint8x8_t packed = vcreate_u8(pixels);
+	return vzip_u8(vand_u8(packed, vdup_n_u8(0x0F)), vshr_n_u8(packed, 4));
+}
+
+static inline uint8x8_t neon_lookup(uint8x16_t table, uint8x8_t indexes)
+{
+#if defined(__aarch64__)
+	return vqtbl1_u8(table, indexes);
+#else
+	uint8x8x2_t split = { { vget_low_u8(table), vget_high_u8(table) } };
+	return vtbl2_u8(split, indexes);
+#endif
+}
+
+static inline uint16x8_t neon_lookup_colors(uint8x16x2_t palette, uint8x8_t indexes)
+{
+	uint8x8x2_t colors = vzip_u8(neon_lookup(palette.val[0], indexes), neon_lookup(palette.val[1], indexes));
+	return vreinterpretq_u16_u8(vcombine_u8(colors.val[0], colors.val[1]));
+}
+
+// Keeps the frame buffer for transparent pixels, stores the colors elsewhere
+static inline void neon_blend_store(uint16_t* frame_buffer, uint8x16x2_t palette, uint8x8_t indexes)
+{
+	uint16x8_t transparent = vceqq_u16(vmovl_u8(indexes), vdupq_n_u16(0));
+	vst1q_u16(frame_buffer, vbslq_u16(transparent, vld1q_u16(frame_buffer), neon_lookup_colors(palette, indexes)));
+}
+
+static void draw_pixels_16_neon(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	uint8x8x2_t indexes = neon_unpack_indexes(pixels);
+	uint8x16x2_t palette_bytes = vld2q_u8((const uint8_t *)palette);	// low bytes, high bytes
+
+	neon_blend_store(frame_buffer, palette_bytes, indexes.val[0]);
+	neon_blend_store(frame_buffer + 8, palette_bytes, indexes.val[1]);
+}
+
+static void draw_pixels_8_neon(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	uint8x8x2_t indexes = neon_unpack_indexes(pixels);
+	uint8x16x2_t palette_bytes = vld2q_u8((const uint8_t *)palette);
+
+	neon_blend_store(frame_buffer, palette_bytes, indexes.val[0]);
+}
+
+static void copy_pixels_8_neon(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	uint8x8x2_t indexes = neon_unpack_indexes(pixels);
+	uint8x16x2_t palette_bytes = vld2q_u8((const uint8_t *)palette);
+
+	vst1q_u16(frame_buffer, neon_lookup_colors(palette_bytes, indexes.val[0]));
+}
+
+static void copy_pixels_16_neon(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer)
+{
+	uint8x8x2_t indexes = neon_unpack_indexes(pixels);
+	uint8x16x2_t palette_bytes = vld2q_u8((const uint8_t *)palette);
+
+	vst1q_u16(frame_buffer, neon_lookup_colors(palette_bytes, indexes.val[0]));
+	vst1q_u16(frame_buffer + 8, neon_lookup_colors(palette_bytes, indexes.val[1]));
+}
+
+#endif /* VIDEO_KERNELS_NEON */
+
+#pragma mark - Public
+
+video_pixels_kernel_t video_draw_pixels_16 = draw_pixels_16_scalar;
+video_pixels_kernel_t video_copy_pixels_16 = copy_pixels_16_scalar;
+video_pixels_kernel_t video_draw_pixels_8 = draw_pixels_8_scalar;
+video_pixels_kernel_t video_copy_pixels_8 = copy_pixels_8_scalar;
+
+void video_kernels_init(uint64_t cpu_features) {
+	const char *name = "scalar";
+	video_draw_pixels_16 = draw_pixels_16_scalar;
+	video_copy_pixels_16 = copy_pixels_16_scalar;
+	video_draw_pixels_8 = draw_pixels_8_scalar;
+	video_copy_pixels_8 = copy_pixels_8_scalar;
+
+#if defined(VIDEO_KERNELS_SSE2)
+	// SSE2 is part of x86-64, SSSE3 is only used when the cpu has it
+	name = "SSE2";
+	video_draw_pixels_16 = draw_pixels_16_sse2;
+	video_copy_pixels_16 = copy_pixels_16_sse2;
+	video_draw_pixels_8 = draw_pixels_8_sse2;
+	video_copy_pixels_8 = copy_pixels_8_sse2;
+#if defined(VIDEO_KERNELS_SSSE3)
+	if (cpu_features == 0 && __builtin_cpu_supports("ssse3"))
+		cpu_features = RETRO_SIMD_SSSE3;	// the frontend has no perf interface
+	if (cpu_features & RETRO_SIMD_SSSE3) {
+		name = "SSSE3";
+		video_draw_pixels_16 = draw_pixels_16_ssse3;
+		video_copy_pixels_16 = copy_pixels_16_ssse3;
+		video_draw_pixels_8 = draw_pixels_8_ssse3;
+		video_copy_pixels_8 = copy_pixels_8_ssse3;
+	}
+#endif
+#elif defined(VIDEO_KERNELS_NEON)
+	name = "NEON";
+	video_draw_pixels_16 = draw_pixels_16_neon;
+	video_copy_pixels_16 = copy_pixels_16_neon;
+	video_draw_pixels_8 = draw_pixels_8_neon;
+	video_copy_pixels_8 = copy_pixels_8_neon;
+#endif
+
+	LOG(LOG_INFO, "video: %s pixels kernels\n", name);
+}
@@ -0,0 +1,27 @@
+#ifndef video_kernels_h
+#define video_kernels_h
+
+#include <stdint.h>
+
+// Pixels are packed as 4 bits palette indexes, pixel i in bits 4*i to 4*i+3.
+// Index 0 is transparent, others are looked up in the 16 colors palette and stored.
+typedef void (*video_pixels_kernel_t)(uint64_t pixels, const uint16_t* palette, uint16_t* frame_buffer);
+
+extern video_pixels_kernel_t video_draw_pixels_16;	// 16 pixels (a full sprite tile line)
+extern video_pixels_kernel_t video_copy_pixels_16;	// same, when no pixel is transparent
+extern video_pixels_kernel_t video_draw_pixels_8;	// 8 pixels from the low 32 bits (a fix tile line)
+extern video_pixels_kernel_t video_copy_pixels_8;	// same, when no pixel is transparent
+
+// Selects the fastest kernels for the given RETRO_SIMD_* cpu features
+void video_kernels_init(uint64_t cpu_features);
+
+// Reverses the pixels order for horizontally flipped tiles
+static inline uint64_t video_reverse_pixels_16(uint64_t pixels)
+{
+	pixels = ((pixels >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((pixels & 0x0F0F0F0F0F0F0F0FULL) << 4);
+	pixels = ((pixels >> 8) & 0x00FF00FF00FF00FFULL) | ((pixels & 0x00FF00FF00FF00FFULL) << 8);
+	pixels = ((pixels >> 16) & 0x0000FFFF0000FFFFULL) | ((pixels & 0x0000FFFF0000FFFFULL) << 16);
+	return (pixels >> 32) | (pixels << 32);
+}
+
+#endif /* video_kernels_h */